@@ -0,0 +1,473 @@
+// tccp-bench: transport and sync benchmarks against a local stand-in cluster.
+//
+// The fake cluster (bench/fake/bin) puts shim ssh/sbatch/squeue/... scripts
+// first on PATH: every "remote" command runs locally under bash, with HOME
+// pointed at a scratch directory standing in for the cluster's NFS home.
+// TCCP_FAKE_SSH_DELAY (seconds, set via --ssh-delay) adds latency per hop.
+//
+// Results are written as JSON so runs can be compared over time:
+//   { "version": ..., "timestamp": ..., "config": {...},
+//     "results": [ { "name": "ssh.run", "unit": "ms", "value": <mean>,
+//                    "samples": N, "p50": ..., "p95": ..., "min": ..., "max": ... },
+//                  { "name": "tar_push.throughput", "unit": "MB/s", "value": ... }, ... ] }
+//
+// The ignore suite is in-process and needs no fake cluster.
+
+#include "config.hpp"
+#include "ignore.hpp"
+#include "session.hpp"
+#include "ssh.hpp"
+#include "state.hpp"
+#include "sync.hpp"
+#include "timing.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+
+#ifndef TCCP_BENCH_FAKE_BIN
+#define TCCP_BENCH_FAKE_BIN "bench/fake/bin"
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point t0) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+}
+
+// ── Results ───────────────────────────────────────────────
+
+struct Metric {
+    std::string name, unit;
+    double value = 0;
+    std::vector<double> samples;  // empty for single-value metrics
+};
+
+class Report {
+public:
+    void add(const std::string& name, const std::string& unit, double value) {
+        metrics_.push_back({name, unit, value, {}});
+        std::cerr << fmt::format("  {:<28} {:>10.2f} {}\n", name, value, unit);
+    }
+
+    void add_samples(const std::string& name, const std::string& unit, std::vector<double> samples) {
+        if (samples.empty()) return;
+        double sum = 0;
+        for (double s : samples) sum += s;
+        Metric m{name, unit, sum / samples.size(), std::move(samples)};
+        std::sort(m.samples.begin(), m.samples.end());
+        std::cerr << fmt::format("  {:<28} {:>10.2f} {} (p50 {:.2f}, p95 {:.2f}, n={})\n",
+                                 name, m.value, unit, pct(m.samples, 50), pct(m.samples, 95),
+                                 m.samples.size());
+        metrics_.push_back(std::move(m));
+    }
+
+    std::string json(const std::vector<std::pair<std::string, std::string>>& config) const {
+        std::string out = "{\n";
+        out += fmt::format("  \"version\": {},\n", quote(TCCP_VERSION));
+        out += fmt::format("  \"timestamp\": {},\n", static_cast<long long>(std::time(nullptr)));
+        out += "  \"config\": {";
+        for (size_t i = 0; i < config.size(); i++) {
+            out += fmt::format("{}{}: {}", i ? ", " : "", quote(config[i].first), quote(config[i].second));
+        }
+        out += "},\n  \"results\": [\n";
+        for (size_t i = 0; i < metrics_.size(); i++) {
+            const auto& m = metrics_[i];
+            out += fmt::format("    {{\"name\": {}, \"unit\": {}, \"value\": {:.4f}",
+                               quote(m.name), quote(m.unit), m.value);
+            if (!m.samples.empty()) {
+                out += fmt::format(", \"samples\": {}, \"p50\": {:.4f}, \"p95\": {:.4f}, "
+                                   "\"min\": {:.4f}, \"max\": {:.4f}",
+                                   m.samples.size(), pct(m.samples, 50), pct(m.samples, 95),
+                                   m.samples.front(), m.samples.back());
+            }
+            out += i + 1 < metrics_.size() ? "},\n" : "}\n";
+        }
+        out += "  ]\n}\n";
+        return out;
+    }
+
+private:
+    std::vector<Metric> metrics_;
+
+    static double pct(const std::vector<double>& sorted, int p) {
+        size_t idx = (sorted.size() - 1) * static_cast<size_t>(p) / 100;
+        return sorted[idx];
+    }
+
+    static std::string quote(const std::string& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += fmt::format("\\u{:04x}", c);
+                continue;
+            }
+            out += c;
+        }
+        return out + "\"";
+    }
+};
+
+// ── Fake cluster ──────────────────────────────────────────
+
+struct Options {
+    std::string out;
+    std::string fake_bin = TCCP_BENCH_FAKE_BIN;
+    std::set<std::string> suites = {"ssh", "tar", "start", "ignore"};
+    int iterations = 20;
+    int files = 500;
+    int file_kb = 16;
+    int big_mb = 64;
+    std::string ssh_delay;
+    bool keep = false;
+};
+
+struct Env {
+    fs::path root, home, remote, project;
+};
+
+void write_file(const fs::path& p, const std::string& data) {
+    fs::create_directories(p.parent_path());
+    std::ofstream(p, std::ios::binary) << data;
+}
+
+// Random bytes: compressible-looking data would flatter any future
+// compression stage.
+std::string random_bytes(size_t n, std::mt19937_64& rng) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; i += 8) {
+        uint64_t v = rng();
+        for (size_t j = 0; j < 8 && i + j < n; j++) s[i + j] = static_cast<char>(v >> (8 * j));
+    }
+    return s;
+}
+
+Result<Env> setup_env(const Options& opt) {
+    Env env;
+    std::string tmpl = (fs::temp_directory_path() / "tccp-bench-XXXXXX").string();
+    if (!mkdtemp(tmpl.data())) return Result<Env>::Err("mkdtemp failed");
+    env.root = tmpl;
+    env.home = env.root / "home";
+    env.remote = env.root / "remote";
+    env.project = env.root / "proj";
+    fs::create_directories(env.home / ".tccp");
+    fs::create_directories(env.remote);
+
+    fs::path bin = fs::absolute(opt.fake_bin);
+    if (!fs::exists(bin / "ssh")) {
+        return Result<Env>::Err(fmt::format("fake cluster not found at {}", bin.string()));
+    }
+    std::string path = bin.string() + ":" + (std::getenv("PATH") ? std::getenv("PATH") : "");
+    setenv("PATH", path.c_str(), 1);
+    setenv("HOME", env.home.c_str(), 1);
+    setenv("TCCP_FAKE_REMOTE_HOME", env.remote.c_str(), 1);
+    if (!opt.ssh_delay.empty()) setenv("TCCP_FAKE_SSH_DELAY", opt.ssh_delay.c_str(), 1);
+
+    write_file(env.home / ".tccp" / "config.yaml",
+               "host: fake-dtn\nlogin: fake-login\nuser: tccp-bench\npassword: x\n");
+    write_file(env.project / "tccp.yaml", "container: fake/image:1\ngpu: a100\n");
+
+    std::mt19937_64 rng(42);
+    for (int i = 0; i < opt.files; i++) {
+        write_file(env.project / "src" / fmt::format("d{:02}", i % 32) / fmt::format("f{:05}.dat", i),
+                   random_bytes(static_cast<size_t>(opt.file_kb) * 1024, rng));
+    }
+    if (opt.big_mb > 0) {
+        write_file(env.project / "data" / "big.bin",
+                   random_bytes(static_cast<size_t>(opt.big_mb) << 20, rng));
+    }
+    return Result<Env>::Ok(env);
+}
+
+uint64_t tree_bytes(const fs::path& dir, std::vector<std::string>* rel = nullptr) {
+    uint64_t total = 0;
+    for (const auto& e : fs::recursive_directory_iterator(dir)) {
+        if (!e.is_regular_file()) continue;
+        total += e.file_size();
+        if (rel) rel->push_back(fs::relative(e.path(), dir).string());
+    }
+    return total;
+}
+
+// ── Suites ────────────────────────────────────────────────
+
+void bench_ssh(SSH& ssh, const Options& opt, Report& report) {
+    auto sample = [&](const std::string& name, const std::function<SSHResult()>& call) {
+        call();  // warm-up: inner ControlMaster, page cache
+        std::vector<double> ms;
+        for (int i = 0; i < opt.iterations; i++) {
+            auto t0 = clock_type::now();
+            auto r = call();
+            ms.push_back(ms_since(t0));
+            if (!r.ok()) {
+                std::cerr << fmt::format("  {} failed: {}\n", name, r.err);
+                return;
+            }
+        }
+        report.add_samples(name, "ms", std::move(ms));
+    };
+    sample("ssh.run", [&] { return ssh.run("true"); });
+    sample("ssh.run_login", [&] { return ssh.run_login("true"); });
+    sample("ssh.run_compute", [&] { return ssh.run_compute("fakenode", "true"); });
+    sample("ssh.run_batch_x8", [&] {
+        auto rs = ssh.run_batch(Target::compute("fakenode"), std::vector<std::string>(8, "true"));
+        for (const auto& r : rs) if (!r.ok()) return r;
+        return SSHResult{0, "", ""};
+    });
+}
+
+void bench_tar(SSH& ssh, const Env& env, Report& report) {
+    std::vector<std::string> files;
+    uint64_t bytes = tree_bytes(env.project, &files);
+    double mb = static_cast<double>(bytes) / (1 << 20);
+    report.add("tar.bytes", "MB", mb);
+
+    fs::path remote_dir = env.remote / "tar-bench";
+    auto t0 = clock_type::now();
+    auto push = ssh.tar_push("fakenode", env.project, files, remote_dir.string());
+    double push_s = ms_since(t0) / 1000;
+    if (push.is_err()) {
+        std::cerr << "  tar_push failed: " << push.error << "\n";
+        return;
+    }
+    report.add("tar_push.seconds", "s", push_s);
+    report.add("tar_push.throughput", "MB/s", mb / push_s);
+
+    fs::path local_dir = env.root / "pulled";
+    t0 = clock_type::now();
+    auto pull = ssh.tar_pull(remote_dir.string(), local_dir, files);
+    double pull_s = ms_since(t0) / 1000;
+    if (pull.is_err()) {
+        std::cerr << "  tar_pull failed: " << pull.error << "\n";
+        return;
+    }
+    report.add("tar_pull.seconds", "s", pull_s);
+    report.add("tar_pull.throughput", "MB/s", mb / pull_s);
+}
+
+void bench_start(const Env& env, Report& report) {
+    auto cfg = load_config(env.project);
+    if (cfg.is_err()) {
+        std::cerr << "  config: " << cfg.error << "\n";
+        return;
+    }
+    SSH ssh(cfg.value.global.host, cfg.value.global.login, cfg.value.global.user,
+            cfg.value.global.password);
+    ssh.connect();
+    Sync sync(ssh, cfg.value);
+    StateStore store(cfg.value.project_name);
+    Session session(cfg.value, ssh, sync, store);
+
+    auto t0 = clock_type::now();
+    auto started = session.start(nullptr);
+    double total = ms_since(t0) / 1000;
+    if (started.is_err()) {
+        std::cerr << "  start failed: " << started.error << "\n";
+        return;
+    }
+    report.add("start.total", "s", total);
+    for (const auto& p : session.start_timing().phases()) {
+        report.add("start." + p.name, "s", p.secs);
+    }
+
+    // Incremental sync with one changed file, the common loop case
+    write_file(env.project / "src" / "touched.txt", std::to_string(std::time(nullptr)));
+    t0 = clock_type::now();
+    auto synced = session.sync_files(nullptr);
+    if (synced.is_ok()) report.add("sync.one_change", "ms", ms_since(t0));
+
+    t0 = clock_type::now();
+    auto exec = session.exec("true", ProcIO{});
+    if (exec.is_ok()) report.add("exec.true", "ms", ms_since(t0));
+
+    session.stop(nullptr);
+}
+
+// A Python/ML project's .gitignore in the style of GitHub's templates, on
+// top of tccp's built-in defaults.
+const char* IGNORE_PATTERNS[] = {
+    ".git/", ".gitignore", ".tccpignore", "__pycache__/", "*.pyc", "*.pyo",
+    ".venv/", "venv/", ".idea/", ".vscode/", ".claude/", ".DS_Store", "*.swp",
+    "*.swo", "*~", ".cache/", "build/", "dist/", "*.egg-info/", ".pytest_cache/",
+    ".mypy_cache/", "node_modules/", ".env", "output/", ".tccp.sock", ".tccp-env.sh",
+    "*.py[cod]", "*$py.class", "*.so", ".Python", "develop-eggs/", "downloads/",
+    "eggs/", ".eggs/", "lib64/", "parts/", "sdist/", "var/", "wheels/",
+    "*.egg", "MANIFEST", "*.manifest", "*.spec", "pip-log.txt", "htmlcov/",
+    ".tox/", ".nox/", ".coverage", ".coverage.*", "nosetests.xml", "coverage.xml",
+    "*.cover", ".hypothesis/", "*.mo", "*.pot", "*.log", "local_settings.py",
+    "db.sqlite3", "instance/", ".webassets-cache", ".scrapy", "docs/_build/",
+    "target/", ".ipynb_checkpoints", "profile_default/", "ipython_config.py",
+    "celerybeat-schedule", "*.sage.py", "env/", "ENV/", "env.bak/", "venv.bak/",
+    ".spyderproject", ".ropeproject", "/site", ".dmypy.json", ".pyre/",
+    "wandb/", "mlruns/", "lightning_logs/", "checkpoints/", "runs/*/events.*",
+    "*.ckpt", "*.pt", "!pretrained/*.pt", "data/raw/", "data/**/*.tmp",
+    "outputs/", "multirun/", "*.npy", "!fixtures/*.npy", "slurm-*.out",
+};
+
+void bench_ignore(const Options& opt, Report& report) {
+    IgnoreMatcher m;
+    for (const char* p : IGNORE_PATTERNS) {
+        std::string raw = p;
+        bool neg = raw[0] == '!';
+        m.add(neg ? raw.substr(1) : raw, neg);
+    }
+    m.force_include("data/raw/keep");
+
+    auto t0 = clock_type::now();
+    m.compile();
+    report.add("ignore.compile", "ms", ms_since(t0));
+
+    static const char* dirs[] = {
+        "src", "models", "data", "raw", "processed", "checkpoints", "pretrained",
+        "fixtures", "__pycache__", "build", "scripts", "notebooks", "runs", "exp1",
+        "utils", "tests", "configs", "wandb", "lib", "keep", "node_modules", "docs",
+    };
+    static const char* files[] = {
+        "train.py", "model.py", "utils.pyc", "config.yaml", "weights.pt", "README.md",
+        "events.out.tfevents", "log.log", "x.npy", "slurm-123.out", "data.csv",
+        "notes.txt~", "run.sh", "lib.so", "a.ckpt", "b.tmp", ".env", "setup.cfg",
+    };
+    std::mt19937_64 rng(7);
+    std::vector<std::string> paths(static_cast<size_t>(opt.files) * 200);
+    for (auto& p : paths) {
+        int depth = 1 + static_cast<int>(rng() % 5);
+        for (int d = 0; d < depth; d++) {
+            p += dirs[rng() % (sizeof(dirs) / sizeof(*dirs))];
+            p += '/';
+        }
+        p += files[rng() % (sizeof(files) / sizeof(*files))];
+    }
+
+    size_t linear_hits = 0, automaton_hits = 0, mismatches = 0;
+    t0 = clock_type::now();
+    for (const auto& p : paths) linear_hits += m.match_linear(p) == IgnoreMatcher::Verdict::Ignored;
+    double linear = ms_since(t0);
+    t0 = clock_type::now();
+    for (const auto& p : paths) automaton_hits += m.match(p) == IgnoreMatcher::Verdict::Ignored;
+    double automaton = ms_since(t0);
+    for (const auto& p : paths) mismatches += m.match(p) != m.match_linear(p);
+
+    double n = static_cast<double>(paths.size());
+    report.add("ignore.linear", "ns/path", linear * 1e6 / n);
+    report.add("ignore.automaton", "ns/path", automaton * 1e6 / n);
+    report.add("ignore.speedup", "x", linear / automaton);
+    report.add("ignore.ignored", "%", 100.0 * static_cast<double>(automaton_hits) / n);
+    // Must be 0: the automaton answers exactly like the per-pattern loop
+    report.add("ignore.mismatches", "paths",
+               static_cast<double>(mismatches + (linear_hits != automaton_hits)));
+}
+
+void usage() {
+    std::cerr <<
+        "usage: tccp-bench [options]\n"
+        "  --out FILE         write JSON results to FILE (default: stdout)\n"
+        "  --suite LIST       comma-separated: ssh,tar,start,ignore (default: all)\n"
+        "  --iterations N     samples per latency metric (default 20)\n"
+        "  --files N          small files in the synthetic project (default 500)\n"
+        "  --file-kb N        size of each small file (default 16)\n"
+        "  --big-mb N         size of one large file (default 64, 0 = none)\n"
+        "  --ssh-delay SECS   extra latency per ssh hop (e.g. 0.02)\n"
+        "  --fake-bin DIR     fake cluster scripts (default: bench/fake/bin)\n"
+        "  --keep             keep the scratch directory\n";
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        try {
+            if (a == "--out") opt.out = next();
+            else if (a == "--fake-bin") opt.fake_bin = next();
+            else if (a == "--iterations") opt.iterations = std::stoi(next());
+            else if (a == "--files") opt.files = std::stoi(next());
+            else if (a == "--file-kb") opt.file_kb = std::stoi(next());
+            else if (a == "--big-mb") opt.big_mb = std::stoi(next());
+            else if (a == "--ssh-delay") opt.ssh_delay = next();
+            else if (a == "--keep") opt.keep = true;
+            else if (a == "--suite") {
+                opt.suites.clear();
+                std::istringstream ss(next());
+                std::string s;
+                while (std::getline(ss, s, ',')) opt.suites.insert(s);
+            } else {
+                return false;
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+
+    Report report;
+    if (opt.suites.count("ignore")) bench_ignore(opt, report);
+
+    bool cluster = opt.suites.count("ssh") || opt.suites.count("tar") || opt.suites.count("start");
+    Env env;
+    if (cluster) {
+        auto env_result = setup_env(opt);
+        if (env_result.is_err()) {
+            std::cerr << "tccp-bench: " << env_result.error << "\n";
+            return 1;
+        }
+        env = env_result.value;
+        std::cerr << "tccp-bench: scratch " << env.root.string() << "\n";
+    }
+
+    if (opt.suites.count("ssh") || opt.suites.count("tar")) {
+        auto g = load_config_global_only();
+        if (g.is_err()) {
+            std::cerr << "tccp-bench: " << g.error << "\n";
+            return 1;
+        }
+        SSH ssh(g.value.host, g.value.login, g.value.user, g.value.password);
+        auto conn = ssh.connect();
+        if (conn.is_err()) {
+            std::cerr << "tccp-bench: " << conn.error << "\n";
+            return 1;
+        }
+        if (opt.suites.count("ssh")) bench_ssh(ssh, opt, report);
+        if (opt.suites.count("tar")) bench_tar(ssh, env, report);
+    }
+    if (opt.suites.count("start")) bench_start(env, report);
+
+    std::string json = report.json({
+        {"iterations", std::to_string(opt.iterations)},
+        {"files", std::to_string(opt.files)},
+        {"file_kb", std::to_string(opt.file_kb)},
+        {"big_mb", std::to_string(opt.big_mb)},
+        {"ssh_delay", opt.ssh_delay.empty() ? "0" : opt.ssh_delay},
+    });
+    if (opt.out.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(opt.out) << json;
+        std::cerr << "tccp-bench: wrote " << opt.out << "\n";
+    }
+
+    if (cluster && !opt.keep) {
+        std::error_code ec;
+        fs::remove_all(env.root, ec);
+    }
+    return 0;
+}
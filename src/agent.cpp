@@ -0,0 +1,962 @@
+#include "agent.hpp"
+#include "wire.hpp"
+#include "debug.hpp"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// ── Agent program ─────────────────────────────────────────
+// Frame: u32 length (big-endian) followed by that many bytes.
+// Request body: u8 op, then op arguments. Reply body: u8 status (0 ok,
+// 1 error), then results, or an error message. Strings are u32 length +
+// bytes; integers are big-endian. The agent greets with an ok frame
+// carrying its version string.
+
+enum AgentOp : uint8_t {
+    OP_EXEC = 1,
+    OP_STAT = 2,
+    OP_WRITE = 3,
+    OP_LIST = 4,
+    OP_MANIFEST = 5,
+    OP_SIGNATURE = 6,
+    OP_PATCH = 7,
+    OP_SUMS = 8,
+    OP_CAS_PUT = 9,
+    OP_CAS_GET = 10,
+    OP_QUIT = 127,
+};
+
+static const char* AGENT_VERSION = "tccp-agent 6";
+
+static const char* AGENT_SOURCE = R"PY(
+import hashlib, os, shutil, stat, struct, subprocess, sys, threading, time, zlib
+R = sys.stdin.buffer
+W = sys.stdout.buffer
+ENC = 'surrogateescape'
+
+def rd(n):
+    b = R.read(n)
+    if len(b) < n:
+        sys.exit(0)
+    return b
+
+class In:
+    def __init__(self, b):
+        self.b = b
+        self.o = 5
+    def u32(self):
+        v = struct.unpack_from('>I', self.b, self.o)[0]
+        self.o += 4
+        return v
+    def i64(self):
+        v = struct.unpack_from('>q', self.b, self.o)[0]
+        self.o += 8
+        return v
+    def raw(self):
+        n = self.u32()
+        v = self.b[self.o:self.o + n]
+        self.o += n
+        return v
+    def str(self):
+        return os.fsdecode(self.raw())
+
+def u8(v): return struct.pack('>B', v)
+def u32(v): return struct.pack('>I', v)
+def i32(v): return struct.pack('>i', v)
+def i64(v): return struct.pack('>q', int(v))
+def sb(v):
+    if isinstance(v, str):
+        v = os.fsencode(v)
+    return u32(len(v)) + v
+
+WL = threading.Lock()
+
+def send(rid, status, payload):
+    with WL:
+        W.write(u32(len(payload) + 5) + u32(rid) + u8(status) + payload)
+        W.flush()
+
+def kind(m):
+    if stat.S_ISREG(m): return 1
+    if stat.S_ISDIR(m): return 2
+    if stat.S_ISSOCK(m): return 3
+    return 4
+
+def path(p):
+    return os.path.expanduser(p)
+
+def md5(b=b''):
+    try:
+        return hashlib.md5(b, usedforsecurity=False)
+    except TypeError:
+        return hashlib.md5(b)
+
+def op_exec(a):
+    cmd = a.str()
+    timeout = a.u32()
+    try:
+        r = subprocess.run(['bash', '-c', cmd], stdin=subprocess.DEVNULL,
+                           stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                           timeout=timeout or None)
+        return i32(r.returncode) + sb(r.stdout) + sb(r.stderr)
+    except subprocess.TimeoutExpired:
+        return i32(-1) + sb(b'') + sb(b'command timed out')
+
+def op_stat(a):
+    try:
+        s = os.stat(path(a.str()))
+    except OSError:
+        return u8(0) + i64(0) + i64(0) + u32(0)
+    return u8(kind(s.st_mode)) + i64(s.st_size) + i64(s.st_mtime) + u32(stat.S_IMODE(s.st_mode))
+
+def op_write(a):
+    p = path(a.str())
+    mode = a.u32()
+    data = a.raw()
+    d = os.path.dirname(p)
+    if d:
+        os.makedirs(d, exist_ok=True)
+    tmp = p + '.tccp-tmp'
+    with open(tmp, 'wb') as f:
+        f.write(data)
+    os.chmod(tmp, mode)
+    os.replace(tmp, p)
+    return b''
+
+def op_list(a):
+    out = []
+    with os.scandir(path(a.str())) as it:
+        for e in it:
+            try:
+                s = e.stat(follow_symlinks=True)
+            except OSError:
+                continue
+            out.append(sb(e.name) + u8(kind(s.st_mode)) + i64(s.st_size) + i64(s.st_mtime))
+    return u32(len(out)) + b''.join(out)
+
+def op_manifest(a):
+    root = path(a.str())
+    out = []
+    for d, dirs, files in os.walk(root):
+        rel = os.path.relpath(d, root)
+        for f in files:
+            try:
+                s = os.lstat(os.path.join(d, f))
+            except OSError:
+                continue
+            if not stat.S_ISREG(s.st_mode):
+                continue
+            r = f if rel == '.' else rel + '/' + f
+            out.append(sb(r) + i64(s.st_size) + i64(s.st_mtime))
+    return u32(len(out)) + b''.join(out)
+
+def op_signature(a):
+    p = path(a.str())
+    bs = a.u32()
+    out = []
+    with open(p, 'rb') as f:
+        size = os.fstat(f.fileno()).st_size
+        while True:
+            b = f.read(bs)
+            if not b:
+                break
+            out.append(u32(zlib.adler32(b) & 0xffffffff) + md5(b).digest())
+    return i64(size) + u32(len(out)) + b''.join(out)
+
+def op_patch(a):
+    p = path(a.str())
+    bs = a.u32()
+    size = a.i64()
+    mtime = a.i64()
+    digest = a.raw()
+    ops = memoryview(a.raw())
+    h = md5()
+    tmp = p + '.tccp-tmp'
+    try:
+        with open(p, 'rb') as src, open(tmp, 'wb') as dst:
+            o = 0
+            while o < len(ops):
+                k = ops[o]
+                if k == 67:
+                    first, count = struct.unpack_from('>II', ops, o + 1)
+                    o += 9
+                    src.seek(first * bs)
+                    left = count * bs
+                    while left > 0:
+                        b = src.read(min(left, 1 << 20))
+                        if not b:
+                            break
+                        h.update(b)
+                        dst.write(b)
+                        left -= len(b)
+                elif k == 76:
+                    n = struct.unpack_from('>I', ops, o + 1)[0]
+                    b = ops[o + 5:o + 5 + n]
+                    o += 5 + n
+                    h.update(b)
+                    dst.write(b)
+                else:
+                    raise ValueError('bad delta op %d' % k)
+            n = dst.tell()
+        if n != size or h.digest() != digest:
+            raise ValueError('rebuilt file does not match')
+        os.chmod(tmp, stat.S_IMODE(os.stat(p).st_mode))
+        os.utime(tmp, (mtime, mtime))
+        os.replace(tmp, p)
+    except BaseException:
+        try:
+            os.unlink(tmp)
+        except OSError:
+            pass
+        raise
+    return b''
+
+def op_sums(a):
+    out = []
+    for _ in range(a.u32()):
+        p = path(a.str())
+        off = a.i64()
+        n = a.i64()
+        size = -1
+        h = bytes(16)
+        try:
+            with open(p, 'rb') as f:
+                size = os.fstat(f.fileno()).st_size
+                if 0 < n and off + n <= size:
+                    f.seek(off)
+                    m = md5()
+                    while n > 0:
+                        b = f.read(min(n, 1 << 20))
+                        if not b:
+                            break
+                        m.update(b)
+                        n -= len(b)
+                    h = m.digest()
+        except OSError:
+            pass
+        out.append(i64(size) + h)
+    return u32(len(out)) + b''.join(out)
+
+def cas_obj(cas, key):
+    return os.path.join(cas, key[:2], key)
+
+def op_cas_put(a):
+    cas = path(a.str())
+    base = path(a.str())
+    stored = 0
+    nbytes = 0
+    for _ in range(a.u32()):
+        key = a.str()
+        rel = a.str()
+        size = a.i64()
+        digest = a.raw()
+        obj = cas_obj(cas, key)
+        try:
+            os.utime(obj, None)
+            continue
+        except OSError:
+            pass
+        tmp = '%s.%d.%d.tmp' % (obj, os.getpid(), threading.get_ident())
+        try:
+            os.makedirs(os.path.dirname(obj), exist_ok=True)
+            h = md5()
+            with open(os.path.join(base, rel), 'rb') as src, open(tmp, 'wb') as dst:
+                while True:
+                    b = src.read(1 << 20)
+                    if not b:
+                        break
+                    h.update(b)
+                    dst.write(b)
+                n = dst.tell()
+            if n != size or h.digest() != digest:
+                raise OSError('copy does not match the key')
+            os.chmod(tmp, 0o644)
+            os.replace(tmp, obj)
+            stored += 1
+            nbytes += n
+        except OSError:
+            try:
+                os.unlink(tmp)
+            except OSError:
+                pass
+    return u32(stored) + i64(nbytes)
+
+def cas_prune(cas, days):
+    mark = os.path.join(cas, '.pruned')
+    now = time.time()
+    try:
+        if now - os.stat(mark).st_mtime < 86400:
+            return
+    except OSError:
+        pass
+    try:
+        os.makedirs(cas, exist_ok=True)
+        open(mark, 'a').close()
+        os.utime(mark, None)
+        for d in os.scandir(cas):
+            if not d.is_dir():
+                continue
+            for e in os.scandir(d.path):
+                try:
+                    if now - e.stat().st_mtime > days * 86400:
+                        os.unlink(e.path)
+                except OSError:
+                    pass
+    except OSError:
+        pass
+
+def op_cas_get(a):
+    cas = path(a.str())
+    base = path(a.str())
+    days = a.u32()
+    got = []
+    for i in range(a.u32()):
+        key = a.str()
+        rel = a.str()
+        mode = a.u32()
+        mtime = a.i64()
+        obj = cas_obj(cas, key)
+        dst = os.path.join(base, rel)
+        tmp = dst + '.tccp-tmp'
+        try:
+            os.makedirs(os.path.dirname(dst), exist_ok=True)
+            shutil.copyfile(obj, tmp)
+            os.chmod(tmp, mode)
+            os.utime(tmp, (mtime, mtime))
+            os.replace(tmp, dst)
+            os.utime(obj, None)
+            got.append(u32(i))
+        except OSError:
+            try:
+                os.unlink(tmp)
+            except OSError:
+                pass
+    cas_prune(cas, days)
+    return u32(len(got)) + b''.join(got)
+
+OPS = {1: op_exec, 2: op_stat, 3: op_write, 4: op_list, 5: op_manifest,
+       6: op_signature, 7: op_patch, 8: op_sums, 9: op_cas_put, 10: op_cas_get}
+
+def serve(rid, f, body):
+    try:
+        send(rid, 0, f(In(body)))
+    except Exception as e:
+        send(rid, 1, sb('%s: %s' % (type(e).__name__, e)))
+
+# Each request runs on its own thread; replies carry its id
+send(0, 0, sb('@VERSION@'))
+while True:
+    body = rd(struct.unpack('>I', rd(4))[0])
+    rid, op = struct.unpack_from('>IB', body)
+    if op == 127:
+        send(rid, 0, b'')
+        break
+    f = OPS.get(op)
+    if f is None:
+        send(rid, 1, sb('unknown op %d' % op))
+        continue
+    threading.Thread(target=serve, args=(rid, f, body)).start()
+)PY";
+
+// ── Helpers ───────────────────────────────────────────────
+
+namespace {
+
+RemoteStat::Kind kind_from(uint8_t k) {
+    switch (k) {
+        case 1: return RemoteStat::Kind::File;
+        case 2: return RemoteStat::Kind::Dir;
+        case 3: return RemoteStat::Kind::Socket;
+        case 4: return RemoteStat::Kind::Other;
+        default: return RemoteStat::Kind::None;
+    }
+}
+
+// GNU find %y / stat %F letters for the shell fallback.
+RemoteStat::Kind kind_from_letter(char c) {
+    switch (c) {
+        case 'f': return RemoteStat::Kind::File;
+        case 'd': return RemoteStat::Kind::Dir;
+        case 's': return RemoteStat::Kind::Socket;
+        default: return RemoteStat::Kind::Other;
+    }
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(sep, start);
+        if (end == std::string::npos) end = s.size();
+        parts.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+int64_t to_i64(const std::string& s) {
+    try { return static_cast<int64_t>(std::stod(s)); } catch (...) { return 0; }
+}
+
+// Quote a path for the shell fallbacks, leaving a leading ~/ to expand
+std::string sh_path(const std::string& p) {
+    if (p == "~") return p;
+    if (p.rfind("~/", 0) == 0) return "~/" + escape_for_ssh(p.substr(2));
+    return escape_for_ssh(p);
+}
+
+} // namespace
+
+// ── Lifecycle ─────────────────────────────────────────────
+
+Agent::Agent(SSH& ssh, Target target) : ssh_(ssh), target_(std::move(target)) {}
+
+Agent::~Agent() {
+    stop();
+}
+
+bool Agent::running() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return alive();
+}
+
+bool Agent::alive() {
+    if (!proc_) return false;
+    bool broken;
+    {
+        std::lock_guard<std::mutex> lock(reply_mu_);
+        broken = broken_;
+    }
+    if (broken || !proc_->running()) {
+        mark_dead("channel closed");
+        return false;
+    }
+    return true;
+}
+
+bool Agent::start() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (alive()) return true;
+
+    const char* off = std::getenv("TCCP_NO_AGENT");
+    if (off && *off && std::string(off) != "0") return false;
+
+    std::string source = AGENT_SOURCE;
+    auto v = source.find("@VERSION@");
+    source.replace(v, 9, AGENT_VERSION);
+
+    // The bootstrap reads exactly the program from stdin; everything after
+    // it on the same stream is protocol.
+    std::string boot = fmt::format(
+        "command -v python3 >/dev/null 2>&1 || exit 86; "
+        "exec python3 -u -c 'import sys; exec(compile(sys.stdin.buffer.read({}), \"tccp-agent\", \"exec\"))'",
+        source.size());
+
+    proc_ = std::make_unique<Process>();
+    auto sp = ssh_.open_channel(target_, boot, *proc_);
+    if (sp.is_err()) {
+        mark_dead(sp.error);
+        return false;
+    }
+
+    uint8_t status = 1;
+    std::string hello;
+    std::string len_hdr;
+    if (!write_all(source, 30) || !read_exact(len_hdr, 4, 30)) {
+        mark_dead("agent did not start");
+        return false;
+    }
+    uint32_t n = WireIn(len_hdr).u32();
+    std::string body;
+    if (n < 5 || !read_exact(body, n, 30)) {
+        mark_dead("agent handshake failed");
+        return false;
+    }
+    status = static_cast<uint8_t>(body[4]);
+    WireIn in(body);
+    in.o = 5;
+    hello = in.str();
+    if (status != 0 || hello != AGENT_VERSION) {
+        mark_dead("unexpected agent greeting: " + hello);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> rl(reply_mu_);
+        generation_++;
+        broken_ = false;
+    }
+    quit_ = false;
+    reader_ = std::thread([this] { read_replies(); });
+    debug_log("agent", fmt::format("started on {}", target_.node.empty() ? "dtn/login" : target_.node));
+    return true;
+}
+
+void Agent::stop() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!alive()) {
+        proc_.reset();
+        return;
+    }
+    WireOut frame;
+    frame.u32(5);
+    frame.u32(next_id_++);
+    frame.u8(OP_QUIT);
+    write_all(frame.b, 2);
+    proc_->close_stdin();
+    // The agent exits once requests still running there are done
+    {
+        std::unique_lock<std::mutex> rl(reply_mu_);
+        reply_cv_.wait_for(rl, std::chrono::seconds(2), [&] { return broken_; });
+    }
+    quit_ = true;
+    if (reader_.joinable()) reader_.join();
+    proc_.reset();
+    {
+        std::lock_guard<std::mutex> rl(reply_mu_);
+        replies_.clear();
+        broken_ = true;
+    }
+    reply_cv_.notify_all();
+}
+
+void Agent::mark_dead(const std::string& why) {
+    if (proc_ && proc_->running()) proc_->terminate();
+    quit_ = true;
+    if (reader_.joinable()) reader_.join();
+    debug_log("agent", fmt::format("unavailable ({}): {} {}", target_.node, why,
+                                   debug_truncate(stderr_tail_, 1000)));
+    proc_.reset();
+    {
+        std::lock_guard<std::mutex> rl(reply_mu_);
+        replies_.clear();
+        broken_ = true;  // wakes callers still waiting on this channel
+    }
+    reply_cv_.notify_all();
+}
+
+// ── Channel I/O ───────────────────────────────────────────
+
+#ifdef _WIN32
+bool Agent::write_all(const std::string&, int) { return false; }
+bool Agent::read_exact(std::string&, size_t, int) { return false; }
+void Agent::drain_stderr() {}
+#else
+void Agent::drain_stderr() {
+    if (!proc_ || proc_->stderr_fd() < 0) return;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(proc_->stderr_fd(), buf, sizeof(buf))) > 0) {
+        stderr_tail_.append(buf, static_cast<size_t>(n));
+        if (stderr_tail_.size() > 8192) stderr_tail_.erase(0, stderr_tail_.size() - 8192);
+    }
+}
+
+bool Agent::write_all(const std::string& data, int timeout) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    size_t off = 0;
+    while (off < data.size()) {
+        if (!proc_ || proc_->stdin_fd() < 0) return false;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        // stderr is drained by whoever reads stdout
+        pollfd fds[1] = {{proc_->stdin_fd(), POLLOUT, 0}};
+        int r = poll(fds, 1, static_cast<int>(left));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (fds[0].revents & (POLLERR | POLLHUP)) return false;
+        if (!(fds[0].revents & POLLOUT)) continue;
+        ssize_t n = write(proc_->stdin_fd(), data.data() + off, data.size() - off);
+        if (n > 0) { off += static_cast<size_t>(n); continue; }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        return false;
+    }
+    return true;
+}
+
+bool Agent::read_exact(std::string& out, size_t n, int timeout) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    out.clear();
+    out.reserve(n);
+    char buf[65536];
+    while (out.size() < n) {
+        if (!proc_ || proc_->stdout_fd() < 0) return false;
+        long long left = 250;
+        if (timeout >= 0) {
+            left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return false;
+        } else if (quit_) {
+            return false;
+        }
+        pollfd fds[2] = {{proc_->stdout_fd(), POLLIN, 0}, {proc_->stderr_fd(), POLLIN, 0}};
+        int r = poll(fds, proc_->stderr_fd() >= 0 ? 2 : 1, static_cast<int>(left));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (fds[1].revents) drain_stderr();
+        if (!fds[0].revents) continue;
+        ssize_t got = read(proc_->stdout_fd(), buf, std::min(sizeof(buf), n - out.size()));
+        if (got > 0) { out.append(buf, static_cast<size_t>(got)); continue; }
+        if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        return false;  // EOF: agent exited
+    }
+    return true;
+}
+#endif
+
+#ifdef _WIN32
+void Agent::read_replies() {}
+#else
+void Agent::read_replies() {
+    while (true) {
+        std::string hdr, body;
+        if (!read_exact(hdr, 4, -1)) break;
+        uint32_t n = WireIn(hdr).u32();
+        if (n < 5 || !read_exact(body, n, -1)) break;
+        uint32_t id = WireIn(body).u32();
+        {
+            std::lock_guard<std::mutex> lock(reply_mu_);
+            replies_[id] = body.substr(4);
+        }
+        reply_cv_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(reply_mu_);
+        broken_ = true;
+    }
+    reply_cv_.notify_all();
+}
+#endif
+
+bool Agent::call(uint8_t op, const std::string& payload, uint8_t& status,
+                 std::string& reply, int timeout, bool* was_up) {
+    uint32_t id;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        bool up = alive();
+        if (was_up) *was_up = up;
+        if (!up) return false;
+
+        id = next_id_++;
+        generation = generation_;
+        WireOut frame;
+        frame.u32(static_cast<uint32_t>(payload.size() + 5));
+        frame.u32(id);
+        frame.u8(op);
+        frame.b += payload;
+        if (!write_all(frame.b, timeout)) {
+            mark_dead(fmt::format("request {} failed", op));
+            return false;
+        }
+    }
+
+    // Wait for reader_ to hand over the reply (never empty: it has the status)
+    std::string body;
+    {
+        std::unique_lock<std::mutex> lock(reply_mu_);
+        reply_cv_.wait_for(lock, std::chrono::seconds(timeout), [&] {
+            return replies_.count(id) > 0 || broken_ || generation_ != generation;
+        });
+        auto it = replies_.find(id);
+        if (it != replies_.end()) {
+            body = std::move(it->second);
+            replies_.erase(it);
+        }
+    }
+    if (body.empty()) {
+        // Timed out, or the channel broke
+        std::lock_guard<std::mutex> lock(mu_);
+        if (generation == generation_ && proc_) mark_dead(fmt::format("no reply to {}", op));
+        return false;
+    }
+    status = static_cast<uint8_t>(body[0]);
+    reply = body.substr(1);
+    return true;
+}
+
+// ── Operations ────────────────────────────────────────────
+
+SSHResult Agent::exec(const std::string& cmd, int timeout) {
+    WireOut req;
+    req.str(cmd);
+    req.u32(static_cast<uint32_t>(std::max(timeout, 0)));
+    uint8_t status;
+    std::string reply;
+    // A broken channel mid-exec may have run the command already, so only
+    // fall back if the agent was never up.
+    bool was_up = false;
+    if (!call(OP_EXEC, req.b, status, reply, timeout > 0 ? timeout + 10 : 24 * 3600, &was_up)) {
+        if (was_up) return {-1, "", "agent connection lost"};
+        return ssh_.run_on(target_, cmd, timeout);
+    }
+    WireIn in(reply);
+    if (status != 0) return {-1, "", in.str()};
+    SSHResult r;
+    r.exit_code = in.i32();
+    r.out = in.str();
+    r.err = in.str();
+    while (!r.out.empty() && (r.out.back() == '\n' || r.out.back() == '\r')) r.out.pop_back();
+    return r;
+}
+
+Result<RemoteStat> Agent::stat(const std::string& path) {
+    WireOut req;
+    req.str(path);
+    uint8_t status;
+    std::string reply;
+    if (call(OP_STAT, req.b, status, reply, 60)) {
+        WireIn in(reply);
+        if (status != 0) return Result<RemoteStat>::Err(in.str());
+        RemoteStat st;
+        st.kind = kind_from(in.u8());
+        st.size = in.i64();
+        st.mtime = in.i64();
+        st.mode = in.u32();
+        return Result<RemoteStat>::Ok(st);
+    }
+
+    auto r = ssh_.run_on(target_, fmt::format(
+        "stat -L -c '%F|%s|%Y|%a' {} 2>/dev/null || echo none", sh_path(path)));
+    RemoteStat st;
+    auto f = split(trim(r.out), '|');
+    if (f.size() == 4) {
+        if (f[0].find("regular") != std::string::npos) st.kind = RemoteStat::Kind::File;
+        else if (f[0] == "directory") st.kind = RemoteStat::Kind::Dir;
+        else if (f[0] == "socket") st.kind = RemoteStat::Kind::Socket;
+        else st.kind = RemoteStat::Kind::Other;
+        st.size = to_i64(f[1]);
+        st.mtime = to_i64(f[2]);
+        try { st.mode = static_cast<uint32_t>(std::stoul(f[3], nullptr, 8)); } catch (...) {}
+    } else if (!r.ok() && r.exit_code == -1) {
+        return Result<RemoteStat>::Err(r.err);
+    }
+    return Result<RemoteStat>::Ok(st);
+}
+
+Result<bool> Agent::socket_exists(const std::string& path) {
+    auto st = stat(path);
+    if (st.is_err()) return Result<bool>::Err(st.error);
+    return Result<bool>::Ok(st.value.kind == RemoteStat::Kind::Socket);
+}
+
+Result<void> Agent::write_file(const std::string& path, const std::string& data, uint32_t mode) {
+    WireOut req;
+    req.str(path);
+    req.u32(mode);
+    req.str(data);
+    uint8_t status;
+    std::string reply;
+    if (call(OP_WRITE, req.b, status, reply, 120)) {
+        if (status != 0) return Result<void>::Err(WireIn(reply).str());
+        return Result<void>::Ok();
+    }
+
+    auto r = ssh_.run_with_input(target_, fmt::format(
+        "mkdir -p \"$(dirname {p})\" && cat > {t} && chmod {m:o} {t} && mv -f {t} {p}",
+        fmt::arg("p", sh_path(path)), fmt::arg("t", sh_path(path + ".tccp-tmp")),
+        fmt::arg("m", mode)), data, 120);
+    if (!r.ok()) return Result<void>::Err(fmt::format("write {} failed: {}", path, trim(r.err)));
+    return Result<void>::Ok();
+}
+
+Result<std::vector<RemoteDirEntry>> Agent::list_dir(const std::string& path) {
+    using R = Result<std::vector<RemoteDirEntry>>;
+    WireOut req;
+    req.str(path);
+    uint8_t status;
+    std::string reply;
+    std::vector<RemoteDirEntry> entries;
+    if (call(OP_LIST, req.b, status, reply, 120)) {
+        WireIn in(reply);
+        if (status != 0) return R::Err(in.str());
+        uint32_t n = in.u32();
+        for (uint32_t i = 0; i < n && !in.bad; i++) {
+            RemoteDirEntry e;
+            e.name = in.str();
+            e.kind = kind_from(in.u8());
+            e.size = in.i64();
+            e.mtime = in.i64();
+            entries.push_back(std::move(e));
+        }
+        return R::Ok(std::move(entries));
+    }
+
+    auto r = ssh_.run_on(target_, fmt::format(
+        "find -L {} -mindepth 1 -maxdepth 1 -printf '%f\\t%y\\t%s\\t%T@\\0'", sh_path(path)), 120);
+    if (!r.ok()) return R::Err(fmt::format("list {} failed: {}", path, trim(r.err)));
+    for (const auto& rec : split(r.out, '\0')) {
+        auto f = split(rec, '\t');
+        if (f.size() != 4) continue;
+        RemoteDirEntry e;
+        e.name = f[0];
+        e.kind = f[1].empty() ? RemoteStat::Kind::Other : kind_from_letter(f[1][0]);
+        e.size = to_i64(f[2]);
+        e.mtime = to_i64(f[3]);
+        entries.push_back(std::move(e));
+    }
+    return R::Ok(std::move(entries));
+}
+
+Result<std::vector<ManifestEntry>> Agent::manifest(const std::string& root) {
+    using R = Result<std::vector<ManifestEntry>>;
+    WireOut req;
+    req.str(root);
+    uint8_t status;
+    std::string reply;
+    std::vector<ManifestEntry> entries;
+    if (call(OP_MANIFEST, req.b, status, reply, 600)) {
+        WireIn in(reply);
+        if (status != 0) return R::Err(in.str());
+        uint32_t n = in.u32();
+        entries.reserve(n);
+        for (uint32_t i = 0; i < n && !in.bad; i++) {
+            ManifestEntry e;
+            e.path = in.str();
+            e.size = in.i64();
+            e.mtime = in.i64();
+            entries.push_back(std::move(e));
+        }
+        return R::Ok(std::move(entries));
+    }
+
+    auto r = ssh_.run_on(target_, fmt::format(
+        "cd {} 2>/dev/null || exit 0; find . -type f -printf '%P\\t%s\\t%T@\\0'", sh_path(root)), 600);
+    if (!r.ok()) return R::Err(fmt::format("manifest of {} failed: {}", root, trim(r.err)));
+    for (const auto& rec : split(r.out, '\0')) {
+        auto f = split(rec, '\t');
+        if (f.size() != 3) continue;
+        ManifestEntry e;
+        e.path = f[0];
+        e.size = to_i64(f[1]);
+        e.mtime = to_i64(f[2]);
+        entries.push_back(std::move(e));
+    }
+    return R::Ok(std::move(entries));
+}
+
+Result<FileSignature> Agent::signature(const std::string& path, uint32_t block_size) {
+    using R = Result<FileSignature>;
+    WireOut req;
+    req.str(path);
+    req.u32(block_size);
+    uint8_t status;
+    std::string reply;
+    if (!call(OP_SIGNATURE, req.b, status, reply, 600)) return R::Err("agent unavailable");
+    WireIn in(reply);
+    if (status != 0) return R::Err(in.str());
+    FileSignature sig;
+    sig.block_size = block_size;
+    sig.size = in.i64();
+    uint32_t n = in.u32();
+    sig.blocks.reserve(n);
+    for (uint32_t i = 0; i < n && !in.bad; i++) {
+        BlockSum b;
+        b.weak = in.u32();
+        auto strong = in.bytes(b.strong.size());
+        std::copy(strong.begin(), strong.end(), b.strong.begin());
+        sig.blocks.push_back(b);
+    }
+    if (in.bad) return R::Err("truncated signature");
+    return R::Ok(std::move(sig));
+}
+
+Result<void> Agent::apply_delta(const std::string& path, uint32_t block_size, const Delta& delta) {
+    WireOut req;
+    req.str(path);
+    req.u32(block_size);
+    req.i64(delta.size);
+    req.i64(delta.mtime);
+    req.str(std::string(delta.md5.begin(), delta.md5.end()));
+    req.str(delta.ops);
+    uint8_t status;
+    std::string reply;
+    if (!call(OP_PATCH, req.b, status, reply, 600)) return Result<void>::Err("agent unavailable");
+    if (status != 0) return Result<void>::Err(WireIn(reply).str());
+    return Result<void>::Ok();
+}
+
+Result<std::vector<RemoteRangeSum>> Agent::range_sums(const std::vector<RemoteRange>& ranges) {
+    using R = Result<std::vector<RemoteRangeSum>>;
+    WireOut req;
+    req.u32(static_cast<uint32_t>(ranges.size()));
+    for (const auto& r : ranges) {
+        req.str(r.path);
+        req.i64(r.offset);
+        req.i64(r.len);
+    }
+    uint8_t status;
+    std::string reply;
+    if (!call(OP_SUMS, req.b, status, reply, 600)) return R::Err("agent unavailable");
+    WireIn in(reply);
+    if (status != 0) return R::Err(in.str());
+    uint32_t n = in.u32();
+    std::vector<RemoteRangeSum> sums(n);
+    for (auto& s : sums) {
+        s.size = in.i64();
+        auto digest = in.bytes(s.md5.size());
+        std::copy(digest.begin(), digest.end(), s.md5.begin());
+    }
+    if (in.bad || n != ranges.size()) return R::Err("truncated range sums");
+    return R::Ok(std::move(sums));
+}
+
+Result<CasCount> Agent::cas_put(const std::string& cas_root, const std::string& base,
+                                const std::vector<CasObject>& objects) {
+    WireOut req;
+    req.str(cas_root);
+    req.str(base);
+    req.u32(static_cast<uint32_t>(objects.size()));
+    for (const auto& o : objects) {
+        req.str(o.key);
+        req.str(o.path);
+        req.i64(o.size);
+        req.str(std::string(o.md5.begin(), o.md5.end()));
+    }
+    uint8_t status;
+    std::string reply;
+    if (!call(OP_CAS_PUT, req.b, status, reply, 3600)) return Result<CasCount>::Err("agent unavailable");
+    WireIn in(reply);
+    if (status != 0) return Result<CasCount>::Err(in.str());
+    CasCount c;
+    c.files = in.u32();
+    c.bytes = static_cast<uint64_t>(in.i64());
+    return Result<CasCount>::Ok(c);
+}
+
+Result<std::vector<size_t>> Agent::cas_get(const std::string& cas_root, const std::string& base,
+                                           const std::vector<CasObject>& objects, int keep_days) {
+    using R = Result<std::vector<size_t>>;
+    WireOut req;
+    req.str(cas_root);
+    req.str(base);
+    req.u32(static_cast<uint32_t>(keep_days));
+    req.u32(static_cast<uint32_t>(objects.size()));
+    for (const auto& o : objects) {
+        req.str(o.key);
+        req.str(o.path);
+        req.u32(o.mode);
+        req.i64(o.mtime);
+    }
+    uint8_t status;
+    std::string reply;
+    if (!call(OP_CAS_GET, req.b, status, reply, 3600)) return R::Err("agent unavailable");
+    WireIn in(reply);
+    if (status != 0) return R::Err(in.str());
+    uint32_t n = in.u32();
+    std::vector<size_t> got;
+    got.reserve(n);
+    for (uint32_t i = 0; i < n && !in.bad; i++) {
+        uint32_t idx = in.u32();
+        if (idx < objects.size()) got.push_back(idx);
+    }
+    if (in.bad) return R::Err("truncated cache reply");
+    return R::Ok(std::move(got));
+}
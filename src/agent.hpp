@@ -0,0 +1,142 @@
+#pragma once
+
+#include "types.hpp"
+#include "delta.hpp"
+#include "ssh.hpp"
+#include "proc.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ── Remote helper agent ───────────────────────────────────
+// A small Python program launched once per target over a single ssh
+// channel (stdin/stdout). Requests and replies are length-prefixed binary
+// frames, so a remote stat or file write costs one frame round trip rather
+// than a local ssh spawn plus remote shell parsing. Each request carries an
+// id and runs on its own thread there; a reader thread here hands replies
+// to their callers, so a long op doesn't hold up the others.
+//
+// Every call falls back to an equivalent shell command when the agent
+// can't run on the target (no python3) or has died, so callers never need
+// a second code path.
+
+struct RemoteStat {
+    enum class Kind { None, File, Dir, Socket, Other };
+    Kind kind = Kind::None;
+    int64_t size = 0;
+    int64_t mtime = 0;
+    uint32_t mode = 0;
+    bool exists() const { return kind != Kind::None; }
+};
+
+struct RemoteDirEntry {
+    std::string name;
+    RemoteStat::Kind kind = RemoteStat::Kind::None;
+    int64_t size = 0;
+    int64_t mtime = 0;
+};
+
+// A byte range of a remote file, and what the agent found there: the
+// file's size (-1 = missing) and the MD5 of the range (zero when len is 0
+// or the file is too short).
+struct RemoteRange {
+    std::string path;
+    int64_t offset = 0;
+    int64_t len = 0;
+};
+
+struct RemoteRangeSum {
+    int64_t size = -1;
+    MD5::Digest md5{};
+};
+
+// A file in the cluster-side object cache (Sync::hydrate): key names the
+// object, path is relative to the directory it is copied from or to.
+// cas_put stores a copy only if its size and MD5 match the key's content.
+struct CasObject {
+    std::string key;
+    std::string path;
+    uint32_t mode = 0644;
+    int64_t mtime = 0;
+    int64_t size = 0;
+    MD5::Digest md5{};
+};
+
+struct CasCount {
+    size_t files = 0;
+    uint64_t bytes = 0;
+};
+
+class Agent {
+public:
+    Agent(SSH& ssh, Target target);
+    ~Agent();
+    Agent(const Agent&) = delete;
+    Agent& operator=(const Agent&) = delete;
+
+    // Launch the agent. On failure the instance keeps working via the
+    // shell fallback; returns whether the agent itself is running.
+    bool start();
+    void stop();
+    bool running();
+
+    SSHResult exec(const std::string& cmd, int timeout = 300);
+    Result<RemoteStat> stat(const std::string& path);
+    Result<void> write_file(const std::string& path, const std::string& data, uint32_t mode = 0644);
+    Result<bool> socket_exists(const std::string& path);
+    Result<std::vector<RemoteDirEntry>> list_dir(const std::string& path);
+    // Regular files under root, recursively: relative path, size, mtime.
+    Result<std::vector<ManifestEntry>> manifest(const std::string& root);
+
+    // Delta transfer (delta.hpp). These have no shell fallback; on Err the
+    // caller sends the whole file instead.
+    Result<FileSignature> signature(const std::string& path, uint32_t block_size);
+    Result<void> apply_delta(const std::string& path, uint32_t block_size, const Delta& delta);
+    // Resumed pushes (Sync::push) ask this what an earlier attempt left.
+    // No shell fallback either; on Err everything is sent again.
+    Result<std::vector<RemoteRangeSum>> range_sums(const std::vector<RemoteRange>& ranges);
+
+    // Object cache: copy the files under base into cas_root where it
+    // lacks them, or those it has out to base (returning their indices).
+    // cas_get also drops objects unused for keep_days, at most daily.
+    Result<CasCount> cas_put(const std::string& cas_root, const std::string& base,
+                             const std::vector<CasObject>& objects);
+    Result<std::vector<size_t>> cas_get(const std::string& cas_root, const std::string& base,
+                                        const std::vector<CasObject>& objects, int keep_days);
+
+private:
+    SSH& ssh_;
+    Target target_;
+    std::unique_ptr<Process> proc_;
+    std::string stderr_tail_;
+    std::mutex mu_;   // guards proc_, reader_ and writes to the channel
+    std::thread reader_;
+    std::atomic<bool> quit_{false};   // tells reader_ to give up
+    uint32_t next_id_ = 1;
+    uint64_t generation_ = 0;         // bumped per launch, under mu_ and reply_mu_
+
+    // Replies by request id, from reader_
+    std::mutex reply_mu_;
+    std::condition_variable reply_cv_;
+    std::map<uint32_t, std::string> replies_;
+    bool broken_ = false;             // reader_ saw the channel end
+
+    // Whether the process is up; mu_ held.
+    bool alive();
+    // One request/reply exchange. Returns false if the channel broke, or
+    // was already down (was_up, if given, tells which).
+    bool call(uint8_t op, const std::string& payload, uint8_t& status,
+              std::string& reply, int timeout, bool* was_up = nullptr);
+    bool write_all(const std::string& data, int timeout);
+    // timeout < 0: no deadline, but gives up once quit_ is set.
+    bool read_exact(std::string& out, size_t n, int timeout);
+    void drain_stderr();
+    void read_replies();
+    // Kill the process and the reader; mu_ held.
+    void mark_dead(const std::string& why);
+};
@@ -0,0 +1,498 @@
+#include "archive.hpp"
+#include "debug.hpp"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+static constexpr size_t BLOCK = 512;
+static constexpr size_t NAME_MAX_LEN = 100;
+static const char* LONG_NAME = "././@LongLink";
+
+#ifdef _WIN32
+// ── Windows stubs (not supported) ────────────────────────
+
+Result<void> write_all(int, const char*, size_t) { return Result<void>::Err("not supported on Windows"); }
+Result<void> send_file_range(int, const fs::path&, uint64_t, uint64_t) { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::add(const fs::path&, const std::string&) { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::add_empty(const std::string&) { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::finish() { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::raw(const std::string&) { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::header(const std::string&, char, uint64_t, uint32_t, int64_t, const std::string&) { return Result<void>::Err("not supported on Windows"); }
+Result<void> TarWriter::put(const char*, size_t) { return Result<void>::Err("not supported on Windows"); }
+TarReader::~TarReader() {}
+bool TarReader::feed(const char*, size_t) { return fail("not supported on Windows"); }
+Result<void> TarReader::finish() { return Result<void>::Err("not supported on Windows"); }
+bool TarReader::fail(std::string why) {
+    if (error_.empty()) error_ = std::move(why);
+    return false;
+}
+bool TarReader::on_header() { return false; }
+bool TarReader::open_file(const std::string&, uint64_t) { return false; }
+bool TarReader::close_file() { return false; }
+bool TarReader::end_meta() { return false; }
+bool TarReader::safe_name(const std::string&) const { return false; }
+
+#else
+
+// ── Output helpers ────────────────────────────────────────
+
+// Wait until fd takes more data. False if it never will.
+static bool wait_writable(int fd) {
+    pollfd p{fd, POLLOUT, 0};
+    while (true) {
+        int r = poll(&p, 1, -1);
+        if (r < 0 && errno == EINTR) continue;
+        return r > 0 && !(p.revents & (POLLERR | POLLNVAL));
+    }
+}
+
+Result<void> write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n > 0) {
+            data += n;
+            len -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd)) continue;
+        return Result<void>::Err(fmt::format("write failed: {}", strerror(errno)));
+    }
+    return Result<void>::Ok();
+}
+
+static Result<void> write_zeros(int fd, uint64_t len) {
+    static const char zeros[BLOCK * 8] = {};
+    while (len > 0) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(len, sizeof(zeros)));
+        auto r = write_all(fd, zeros, n);
+        if (r.is_err()) return r;
+        len -= n;
+    }
+    return Result<void>::Ok();
+}
+
+// len bytes of in_fd from offset; zeros past its end (it shrank while
+// we read, which tar pads over the same way).
+static Result<void> send_fd_range(int fd, int in_fd, uint64_t offset, uint64_t len) {
+#ifdef __linux__
+    while (len > 0) {
+        off_t off = static_cast<off_t>(offset);
+        size_t want = static_cast<size_t>(std::min<uint64_t>(len, 1u << 30));
+        ssize_t n = sendfile(fd, in_fd, &off, want);
+        if (n > 0) {
+            offset += static_cast<uint64_t>(n);
+            len -= static_cast<uint64_t>(n);
+            continue;
+        }
+        if (n == 0) return write_zeros(fd, len);
+        if (errno == EINTR) continue;
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd)) continue;
+        if (errno == EINVAL || errno == ENOSYS) break;  // not for this pair: copy instead
+        return Result<void>::Err(fmt::format("sendfile failed: {}", strerror(errno)));
+    }
+    if (len == 0) return Result<void>::Ok();
+#endif
+    std::vector<char> buf(1 << 20);
+    while (len > 0) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(len, buf.size()));
+        ssize_t n = pread(in_fd, buf.data(), want, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return Result<void>::Err(fmt::format("read failed: {}", strerror(errno)));
+        if (n == 0) return write_zeros(fd, len);
+        auto r = write_all(fd, buf.data(), static_cast<size_t>(n));
+        if (r.is_err()) return r;
+        offset += static_cast<uint64_t>(n);
+        len -= static_cast<uint64_t>(n);
+    }
+    return Result<void>::Ok();
+}
+
+Result<void> send_file_range(int fd, const fs::path& src, uint64_t offset, uint64_t len) {
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return Result<void>::Err(fmt::format("{}: {}", src.string(), strerror(errno)));
+    auto r = send_fd_range(fd, in, offset, len);
+    ::close(in);
+    return r;
+}
+
+// ── Headers ───────────────────────────────────────────────
+
+namespace {
+
+// Octal with a NUL, or GNU base-256 when it doesn't fit.
+void put_number(char* field, size_t width, uint64_t v) {
+    if (width - 1 < 22 && v >= (1ull << (3 * (width - 1)))) {
+        std::memset(field, 0, width);
+        for (size_t i = width - 1; i > 0 && v; i--, v >>= 8) field[i] = static_cast<char>(v & 0xff);
+        field[0] = static_cast<char>(0x80);
+        return;
+    }
+    std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1),
+                  static_cast<unsigned long long>(v));
+}
+
+uint64_t get_number(const char* field, size_t width) {
+    auto* u = reinterpret_cast<const unsigned char*>(field);
+    uint64_t v = 0;
+    if (u[0] & 0x80) {
+        for (size_t i = 1; i < width; i++) v = (v << 8) | u[i];
+        return v;
+    }
+    size_t i = 0;
+    while (i < width && (field[i] == ' ' || field[i] == '\0')) i++;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) v = (v << 3) | static_cast<uint64_t>(field[i] - '0');
+    return v;
+}
+
+uint32_t checksum(const char* block) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < BLOCK; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    return sum;
+}
+
+std::string field_str(const char* field, size_t width) {
+    return std::string(field, strnlen(field, width));
+}
+
+uint64_t padding(uint64_t size) {
+    return (BLOCK - size % BLOCK) % BLOCK;
+}
+
+} // namespace
+
+// ── TarWriter ─────────────────────────────────────────────
+
+Result<void> TarWriter::put(const char* data, size_t len) {
+    auto r = write_all(fd_, data, len);
+    if (r.is_ok()) bytes_ += len;
+    return r;
+}
+
+Result<void> TarWriter::raw(const std::string& data) {
+    return put(data.data(), data.size());
+}
+
+Result<void> TarWriter::header(const std::string& name, char type, uint64_t size, uint32_t mode,
+                               int64_t mtime, const std::string& link) {
+    // Long names first, each as a record of its own
+    for (auto [text, kind] : {std::pair<const std::string*, char>{&link, 'K'}, {&name, 'L'}}) {
+        if (text->size() <= NAME_MAX_LEN) continue;
+        auto r = header(LONG_NAME, kind, text->size() + 1, 0644, 0);
+        if (r.is_ok()) r = put(text->c_str(), text->size() + 1);
+        if (r.is_ok()) r = put(std::string(padding(text->size() + 1), '\0').data(), padding(text->size() + 1));
+        if (r.is_err()) return r;
+    }
+
+    char h[BLOCK] = {};
+    std::memcpy(h, name.data(), std::min(name.size(), NAME_MAX_LEN));
+    put_number(h + 100, 8, mode & 07777);
+    put_number(h + 108, 8, 0);
+    put_number(h + 116, 8, 0);
+    put_number(h + 124, 12, size);
+    put_number(h + 136, 12, static_cast<uint64_t>(std::max<int64_t>(mtime, 0)));
+    h[156] = type;
+    std::memcpy(h + 157, link.data(), std::min(link.size(), NAME_MAX_LEN));
+    std::memcpy(h + 257, "ustar  ", 8);  // GNU magic and version
+    std::snprintf(h + 148, 8, "%06o", checksum(h));
+    h[155] = ' ';
+    return put(h, BLOCK);
+}
+
+Result<void> TarWriter::add(const fs::path& src, const std::string& name) {
+    struct stat st;
+    if (lstat(src.c_str(), &st) != 0) {
+        if (errno == ENOENT) {
+            debug_log("tar", fmt::format("{} vanished, skipped", name));
+            return Result<void>::Ok();
+        }
+        return Result<void>::Err(fmt::format("{}: {}", src.string(), strerror(errno)));
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+        std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+        ssize_t n = readlink(src.c_str(), target.data(), target.size());
+        if (n < 0) return Result<void>::Err(fmt::format("{}: {}", src.string(), strerror(errno)));
+        target.resize(static_cast<size_t>(n));
+        return header(name, '2', 0, st.st_mode, st.st_mtime, target);
+    }
+    if (!S_ISREG(st.st_mode)) return Result<void>::Ok();
+
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return Result<void>::Err(fmt::format("{}: {}", src.string(), strerror(errno)));
+    // The size in the header is what goes out, even if the file grows
+    fstat(in, &st);
+    auto size = static_cast<uint64_t>(st.st_size);
+    auto r = header(name, '0', size, st.st_mode, st.st_mtime);
+    if (r.is_ok()) {
+        r = send_fd_range(fd_, in, 0, size);
+        if (r.is_ok()) bytes_ += size;
+    }
+    ::close(in);
+    if (r.is_ok()) r = write_zeros(fd_, padding(size));
+    if (r.is_ok()) bytes_ += padding(size);
+    return r;
+}
+
+Result<void> TarWriter::add_empty(const std::string& name) {
+    return header(name, '0', 0, 0644, 0);
+}
+
+Result<void> TarWriter::finish() {
+    auto r = write_zeros(fd_, 2 * BLOCK);
+    if (r.is_ok()) bytes_ += 2 * BLOCK;
+    return r;
+}
+
+// ── TarReader ─────────────────────────────────────────────
+
+TarReader::~TarReader() {
+    if (out_fd_ >= 0) ::close(out_fd_);
+}
+
+bool TarReader::fail(std::string why) {
+    if (error_.empty()) error_ = std::move(why);
+    if (out_fd_ >= 0) {
+        ::close(out_fd_);
+        out_fd_ = -1;
+    }
+    return false;
+}
+
+bool TarReader::safe_name(const std::string& name) const {
+    if (name.empty() || name[0] == '/') return false;
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find('/', start);
+        if (end == std::string::npos) end = name.size();
+        if (name.compare(start, end - start, "..") == 0 && end - start == 2) return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+bool TarReader::feed(const char* data, size_t len) {
+    if (!error_.empty()) return false;
+    while (len > 0) {
+        if (body_ != Body::None) {
+            if (left_ > 0) {
+                size_t take = static_cast<size_t>(std::min<uint64_t>(left_, len));
+                if (body_ == Body::File) {
+                    auto r = write_all(out_fd_, data, take);
+                    if (r.is_err()) return fail(fmt::format("{}: {}", out_path_.string(), r.error));
+                } else if (body_ == Body::Meta) {
+                    meta_.append(data, take);
+                }
+                data += take;
+                len -= take;
+                left_ -= take;
+            } else {
+                size_t take = static_cast<size_t>(std::min<uint64_t>(pad_, len));
+                data += take;
+                len -= take;
+                pad_ -= take;
+            }
+            if (left_ == 0 && pad_ == 0) {
+                if (body_ == Body::File && !close_file()) return false;
+                if (body_ == Body::Meta && !end_meta()) return false;
+                body_ = Body::None;
+            }
+            continue;
+        }
+        if (ended_) return true;  // whatever follows the end marker is record padding
+
+        size_t take = std::min(BLOCK - block_.size(), len);
+        block_.append(data, take);
+        data += take;
+        len -= take;
+        if (block_.size() == BLOCK) {
+            bool ok = on_header();
+            block_.clear();
+            if (!ok) return false;
+        }
+    }
+    return true;
+}
+
+bool TarReader::on_header() {
+    const char* h = block_.data();
+    if (std::all_of(block_.begin(), block_.end(), [](char c) { return c == '\0'; })) {
+        ended_ = true;
+        return true;
+    }
+    if (get_number(h + 148, 8) != checksum(h)) return fail("bad tar header checksum");
+
+    char type = h[156];
+    uint64_t size = pax_size_ >= 0 ? static_cast<uint64_t>(pax_size_) : get_number(h + 124, 12);
+    left_ = size;
+    pad_ = padding(size);
+
+    if (type == 'L' || type == 'K' || type == 'x') {
+        body_ = Body::Meta;
+        meta_.clear();
+        meta_type_ = type;
+        if (size > (16u << 20)) return fail("tar metadata record too large");
+        return size > 0 || end_meta();
+    }
+
+    // A regular member: its name and link, from whichever record set them
+    std::string name = !long_name_.empty() ? long_name_ : !pax_path_.empty() ? pax_path_ : "";
+    if (name.empty()) {
+        name = field_str(h, NAME_MAX_LEN);
+        if (std::memcmp(h + 257, "ustar\0", 6) == 0 && h[345]) {
+            name = field_str(h + 345, 155) + "/" + name;  // POSIX prefix
+        }
+    }
+    std::string link = !long_link_.empty() ? long_link_ : !pax_link_.empty() ? pax_link_
+                                                        : field_str(h + 157, NAME_MAX_LEN);
+    out_mode_ = static_cast<uint32_t>(get_number(h + 100, 8)) & 0777;
+    out_mtime_ = pax_mtime_ >= 0 ? pax_mtime_ : static_cast<int64_t>(get_number(h + 136, 12));
+    long_name_.clear();
+    long_link_.clear();
+    pax_path_.clear();
+    pax_link_.clear();
+    pax_size_ = pax_mtime_ = -1;
+
+    while (name.size() > 2 && name.compare(0, 2, "./") == 0) name.erase(0, 2);
+    while (!name.empty() && name.back() == '/') name.pop_back();
+    if (name.empty() || name == ".") {
+        body_ = size > 0 ? Body::Skip : Body::None;
+        return true;
+    }
+    if (!safe_name(name)) return fail(fmt::format("refusing tar member {}", name));
+    fs::path path = root_ / name;
+    std::error_code ec;
+    symlinks_.erase(name);  // a later member replaces it
+
+    switch (type) {
+        case '0': case '\0': case '7':
+            return open_file(name, size);
+        case '5':
+            fs::create_directories(path, ec);
+            if (ec) return fail(fmt::format("{}: {}", path.string(), ec.message()));
+            body_ = size > 0 ? Body::Skip : Body::None;
+            return true;
+        case '1': {
+            if (!safe_name(link)) return fail(fmt::format("refusing tar link {}", link));
+            fs::create_directories(path.parent_path(), ec);
+            ::unlink(path.c_str());
+            if (::link((root_ / link).c_str(), path.c_str()) != 0) {
+                return fail(fmt::format("{}: {}", path.string(), strerror(errno)));
+            }
+            files_++;
+            body_ = size > 0 ? Body::Skip : Body::None;
+            return true;
+        }
+        case '2':
+            fs::create_directories(path.parent_path(), ec);
+            symlinks_[name] = link;
+            body_ = size > 0 ? Body::Skip : Body::None;
+            return true;
+        case 'g':
+            body_ = size > 0 ? Body::Skip : Body::None;
+            return true;
+        default:
+            return fail(fmt::format("unsupported tar member type '{}' for {}", type, name));
+    }
+}
+
+bool TarReader::end_meta() {
+    if (meta_type_ == 'L' || meta_type_ == 'K') {
+        std::string value(meta_.c_str());  // up to the NUL
+        (meta_type_ == 'L' ? long_name_ : long_link_) = std::move(value);
+        return true;
+    }
+    // pax: "<len> <key>=<value>\n" records
+    size_t pos = 0;
+    while (pos < meta_.size()) {
+        size_t sp = meta_.find(' ', pos);
+        if (sp == std::string::npos) break;
+        size_t rec_len = 0;
+        try {
+            rec_len = std::stoul(meta_.substr(pos, sp - pos));
+        } catch (...) {
+            return fail("bad pax record");
+        }
+        if (rec_len == 0 || pos + rec_len > meta_.size()) return fail("bad pax record");
+        std::string rec = meta_.substr(sp + 1, pos + rec_len - sp - 2);
+        size_t eq = rec.find('=');
+        if (eq != std::string::npos) {
+            std::string key = rec.substr(0, eq), value = rec.substr(eq + 1);
+            try {
+                if (key == "path") pax_path_ = value;
+                else if (key == "linkpath") pax_link_ = value;
+                else if (key == "size") pax_size_ = std::stoll(value);
+                else if (key == "mtime") pax_mtime_ = static_cast<int64_t>(std::stod(value));
+            } catch (...) {
+                return fail("bad pax record");
+            }
+        }
+        pos += rec_len;
+    }
+    return true;
+}
+
+bool TarReader::open_file(const std::string& name, uint64_t size) {
+    out_path_ = root_ / name;
+    std::error_code ec;
+    fs::create_directories(out_path_.parent_path(), ec);
+    // Replace, don't rewrite: other links to the old file keep its bytes
+    ::unlink(out_path_.c_str());
+    out_fd_ = ::open(out_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out_fd_ < 0) return fail(fmt::format("{}: {}", out_path_.string(), strerror(errno)));
+#ifdef __linux__
+    // Reserve the space up front so the file isn't built from scattered
+    // extents. Filesystems without support just skip it.
+    if (size > 0) fallocate(out_fd_, 0, 0, static_cast<off_t>(size));
+#endif
+    body_ = Body::File;
+    return size > 0 || close_file();
+}
+
+bool TarReader::close_file() {
+    fchmod(out_fd_, out_mode_);
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = out_mtime_;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    futimens(out_fd_, times);
+    int r = ::close(out_fd_);
+    out_fd_ = -1;
+    if (r != 0) return fail(fmt::format("{}: {}", out_path_.string(), strerror(errno)));
+    files_++;
+    if (body_ == Body::File && left_ == 0 && pad_ == 0) body_ = Body::None;
+    return true;
+}
+
+Result<void> TarReader::finish() {
+    if (!error_.empty()) return Result<void>::Err(error_);
+    if (body_ != Body::None || !block_.empty() || !ended_) {
+        fail("archive cut short");
+        return Result<void>::Err(error_);
+    }
+    // A directory made under a symlink's name since stays: unlink fails on it
+    for (const auto& [name, link] : symlinks_) {
+        fs::path path = root_ / name;
+        ::unlink(path.c_str());
+        if (symlink(link.c_str(), path.c_str()) != 0) {
+            fail(fmt::format("{}: {}", path.string(), strerror(errno)));
+            return Result<void>::Err(error_);
+        }
+        files_++;
+    }
+    symlinks_.clear();
+    return Result<void>::Ok();
+}
+
+#endif
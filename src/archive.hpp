@@ -0,0 +1,100 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// ── Tar streams ───────────────────────────────────────────
+// The archives sync and pull exchange with GNU tar on the cluster, made
+// and unpacked here instead of by a local tar. Headers are GNU-flavoured
+// ustar: names past 100 bytes go in a preceding 'L' record, and sizes
+// past 8 GiB in base-256. The reader also takes pax 'x' records, which
+// other tars write for the same purposes.
+
+// Everything written, retrying short writes. fd may be non-blocking.
+Result<void> write_all(int fd, const char* data, size_t len);
+
+// len bytes of src from offset into fd: sendfile (kernel-side, no copy
+// through us) where the platform has it, read/write otherwise. A file
+// shorter than offset + len is padded with zeros.
+Result<void> send_file_range(int fd, const fs::path& src, uint64_t offset, uint64_t len);
+
+class TarWriter {
+public:
+    explicit TarWriter(int fd) : fd_(fd) {}
+
+    // A regular file or symlink, stored as name. A file that vanished
+    // since it was listed is skipped.
+    Result<void> add(const fs::path& src, const std::string& name);
+    // An empty regular file.
+    Result<void> add_empty(const std::string& name);
+    // The two zero blocks that end an archive.
+    Result<void> finish();
+
+    // Bytes ahead of the archive that the receiver reads first.
+    Result<void> raw(const std::string& data);
+    // Everything written to fd so far.
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    int fd_;
+    uint64_t bytes_ = 0;
+
+    Result<void> header(const std::string& name, char type, uint64_t size, uint32_t mode,
+                        int64_t mtime, const std::string& link = "");
+    Result<void> put(const char* data, size_t len);
+};
+
+// Unpacks a tar stream fed in arbitrary pieces (a pump's stdout sink)
+// under root. Files are preallocated to their final size, then written
+// as data arrives; mode and mtime are applied when each is complete.
+// Absolute names and names with ".." are refused. Symlinks are made only
+// once the archive ended, as GNU tar does, so no member can be written
+// through one the same stream planted.
+class TarReader {
+public:
+    explicit TarReader(fs::path root) : root_(std::move(root)) {}
+    ~TarReader();
+    TarReader(const TarReader&) = delete;
+    TarReader& operator=(const TarReader&) = delete;
+
+    // False once the stream turned out bad; error() says why.
+    bool feed(const char* data, size_t len);
+    // Ok if the stream ended cleanly at an archive boundary.
+    Result<void> finish();
+
+    const std::string& error() const { return error_; }
+    size_t files() const { return files_; }
+
+private:
+    fs::path root_;
+    std::string error_;
+    size_t files_ = 0;
+
+    std::string block_;          // partial header block
+    std::string meta_;           // body of a long-name or pax record
+    char meta_type_ = 0;
+    std::string long_name_, long_link_;
+    std::string pax_path_, pax_link_;
+    int64_t pax_size_ = -1, pax_mtime_ = -1;
+
+    // The member whose body is being read
+    enum class Body { None, File, Meta, Skip } body_ = Body::None;
+    uint64_t left_ = 0;          // body bytes still to come
+    uint64_t pad_ = 0;           // then padding to the next block
+    int out_fd_ = -1;
+    fs::path out_path_;
+    uint32_t out_mode_ = 0;
+    int64_t out_mtime_ = 0;
+    bool ended_ = false;         // saw the zero block
+    std::map<std::string, std::string> symlinks_;  // name → target, made by finish()
+
+    bool fail(std::string why);
+    bool on_header();
+    bool open_file(const std::string& name, uint64_t size);
+    bool close_file();
+    bool end_meta();
+    bool safe_name(const std::string& name) const;
+};
@@ -0,0 +1,165 @@
+#include "compress.hpp"
+#include <yaml-cpp/yaml.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <mutex>
+
+// Transfers smaller than this are dominated by round trips, not bandwidth.
+static constexpr uint64_t MIN_SAMPLE_BYTES = 1 << 20;
+// Weight of the newest sample in the moving averages.
+static constexpr double EWMA_NEW = 0.3;
+
+static std::mutex link_mu;
+
+static fs::path link_stats_path() {
+    return home_dir() / ".tccp" / "link.yaml";
+}
+
+static YAML::Node load_all() {
+    try {
+        if (fs::exists(link_stats_path())) return YAML::LoadFile(link_stats_path().string());
+    } catch (...) {
+        // Corrupt stats — start over
+    }
+    return YAML::Node(YAML::NodeType::Map);
+}
+
+static void save_all(const YAML::Node& root) {
+    fs::path path = link_stats_path();
+    fs::create_directories(path.parent_path());
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp);
+        out << root << "\n";
+    }
+    fs::rename(tmp, path);
+}
+
+LinkStats load_link_stats(const std::string& host) {
+    std::lock_guard<std::mutex> lock(link_mu);
+    LinkStats s;
+    try {
+        auto root = load_all();
+        if (root[host]) {
+            s.wire_mbps = root[host]["wire_mbps"].as<double>(0);
+            s.ratio = root[host]["ratio"].as<double>(0);
+            s.streams = root[host]["streams"].as<int>(0);
+        }
+    } catch (...) {}
+    return s;
+}
+
+void record_transfer(const std::string& host, uint64_t raw_bytes, uint64_t wire_bytes,
+                     double seconds, bool measured_ratio) {
+    if (raw_bytes < MIN_SAMPLE_BYTES || wire_bytes == 0 || seconds <= 0) return;
+    std::lock_guard<std::mutex> lock(link_mu);
+    try {
+        auto root = load_all();
+        double mbps = static_cast<double>(wire_bytes) / (1 << 20) / seconds;
+        double ratio = static_cast<double>(wire_bytes) / static_cast<double>(raw_bytes);
+
+        YAML::Node h = root[host];
+        double old_mbps = h["wire_mbps"].as<double>(0);
+        double old_ratio = h["ratio"].as<double>(0);
+        h["wire_mbps"] = old_mbps > 0 ? old_mbps + EWMA_NEW * (mbps - old_mbps) : mbps;
+        if (measured_ratio) {
+            h["ratio"] = old_ratio > 0 ? old_ratio + EWMA_NEW * (ratio - old_ratio) : ratio;
+        }
+        root[host] = h;
+        save_all(root);
+    } catch (...) {
+        // Stats are advisory; never fail a transfer over them
+    }
+}
+
+// A parallel push shorter than this says more about start-up than bandwidth.
+static constexpr uint64_t MIN_PARALLEL_SAMPLE_BYTES = 32 << 20;
+
+void record_parallel(const std::string& host, int streams, uint64_t wire_bytes, double seconds) {
+    if (streams < 1 || wire_bytes < MIN_PARALLEL_SAMPLE_BYTES || seconds <= 0) return;
+    std::lock_guard<std::mutex> lock(link_mu);
+    try {
+        auto root = load_all();
+        YAML::Node h = root[host];
+        double single = h["wire_mbps"].as<double>(0);
+        double per_stream = static_cast<double>(wire_bytes) / (1 << 20) / seconds / streams;
+
+        int next = streams;
+        if (single > 0) {
+            if (per_stream >= 0.7 * single) next = std::min(streams * 2, MAX_STREAMS);
+            else if (per_stream < 0.35 * single) next = std::max(streams / 2, 1);
+        }
+        h["streams"] = next;
+        root[host] = h;
+        save_all(root);
+    } catch (...) {}
+}
+
+Result<int> stream_count(const std::string& setting, const LinkStats& stats) {
+    std::string s = setting;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    if (!s.empty() && s != "auto") {
+        try {
+            int n = std::stoi(s);
+            if (n >= 1 && n <= MAX_STREAMS) return Result<int>::Ok(n);
+        } catch (...) {}
+        return Result<int>::Err(fmt::format(
+            "Invalid streams '{}' in tccp.yaml (use auto or 1-{})", setting, MAX_STREAMS));
+    }
+    return Result<int>::Ok(stats.streams > 0 ? stats.streams : DEFAULT_STREAMS);
+}
+
+Result<int> compression_level(const std::string& setting, const LinkStats& stats) {
+    std::string s = setting;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    if (s == "off" || s == "false" || s == "none" || s == "0") return Result<int>::Ok(0);
+    if (!s.empty() && s != "auto") {
+        try {
+            int level = std::stoi(s);
+            if (level >= 1 && level <= 19) return Result<int>::Ok(level);
+        } catch (...) {}
+        return Result<int>::Err(fmt::format(
+            "Invalid compression '{}' in tccp.yaml (use auto, off, or a level 1-19)", setting));
+    }
+
+    if (!stats.known()) return Result<int>::Ok(3);
+
+    // Slower wire → more CPU is worth spending per byte saved. zstd -T0
+    // keeps up with ~200 MB/s at level 1 even on a laptop.
+    int level;
+    if (stats.wire_mbps >= 200) level = stats.ratio > 0 && stats.ratio < 0.3 ? 1 : 0;
+    else if (stats.wire_mbps >= 50) level = 1;
+    else if (stats.wire_mbps >= 10) level = 3;
+    else if (stats.wire_mbps >= 2) level = 6;
+    else level = 9;
+
+    // Data barely shrinks: keep the cheapest level so the ratio keeps being
+    // measured, without burning CPU.
+    if (stats.ratio > 0.9 && level > 1) level = 1;
+    return Result<int>::Ok(level);
+}
+
+bool is_precompressed(const std::string& path) {
+    static const char* exts[] = {
+        // archives
+        ".gz", ".tgz", ".bz2", ".xz", ".zst", ".zip", ".7z", ".lz4", ".br",
+        // ML checkpoints and arrays (zip- or pickle-of-zip based)
+        ".pt", ".pth", ".ckpt", ".npz", ".safetensors", ".keras",
+        // media
+        ".jpg", ".jpeg", ".png", ".gif", ".webp", ".mp4", ".mkv", ".mov",
+        ".avi", ".mp3", ".flac", ".ogg", ".pdf",
+        // columnar data, container images
+        ".parquet", ".sif", ".squashfs",
+    };
+    auto dot = path.rfind('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) return false;
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    for (const char* e : exts) {
+        if (ext == e) return true;
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.hpp"
+#include <string>
+
+// ── Transfer compression ──────────────────────────────────
+// tar streams between here and the DTN go through zstd when both ends have
+// it. The level comes from tccp.yaml's `compression` (auto | off | 1-19);
+// in auto mode it is picked from what past transfers to the host measured:
+// wire throughput and how well the data compressed.
+
+struct LinkStats {
+    double wire_mbps = 0;   // compressed MB/s actually sent, smoothed
+    double ratio = 0;       // compressed / raw bytes, smoothed (0 = unknown)
+    int streams = 0;        // parallel streams for the next large push (0 = untuned)
+    bool known() const { return wire_mbps > 0; }
+};
+
+// Persisted per host in ~/.tccp/link.yaml.
+LinkStats load_link_stats(const std::string& host);
+void record_transfer(const std::string& host, uint64_t raw_bytes, uint64_t wire_bytes,
+                     double seconds, bool measured_ratio);
+
+// ── Parallel streams ──────────────────────────────────────
+// One ssh channel tops out well below a long fat link's bandwidth, so
+// large pushes are spread over several. The count starts at
+// DEFAULT_STREAMS and is tuned after each parallel push from its
+// throughput per stream, against wire_mbps (what one stream gets): while
+// each stream still gets most of that, the link isn't full and the count
+// doubles; once they clearly share it, it halves.
+
+constexpr int DEFAULT_STREAMS = 4;
+constexpr int MAX_STREAMS = 16;
+
+void record_parallel(const std::string& host, int streams, uint64_t wire_bytes, double seconds);
+// Streams for the next large push from tccp.yaml's `streams` (auto | 1-16).
+// Err for an unparseable setting.
+Result<int> stream_count(const std::string& setting, const LinkStats& stats);
+
+// zstd level for the next transfer, 0 = send uncompressed. Returns
+// Err for an unparseable setting.
+Result<int> compression_level(const std::string& setting, const LinkStats& stats);
+
+// Formats that don't shrink further (checkpoints, archives, media).
+bool is_precompressed(const std::string& path);
@@ -62,7 +62,7 @@ static fs::path global_config_dir() {
     return home_dir() / ".tccp";
 }
 
-static fs::path global_config_path() {
+fs::path global_config_path() {
     return global_config_dir() / "config.yaml";
 }
 
@@ -86,6 +86,7 @@ static GlobalConfig load_global_config() {
         if (root["memory"]) g.memory = root["memory"].as<std::string>("32G");
         if (root["time"]) g.time = root["time"].as<std::string>("4h");
         if (root["cache-containers"]) g.cache_containers = root["cache-containers"].as<bool>(false);
+        if (root["file-cache"]) g.file_cache = root["file-cache"].as<bool>(true);
     } catch (...) {
         // Corrupt config — use defaults
     }
@@ -111,6 +112,9 @@ static ProjectConfig load_project_config(const fs::path& project_dir) {
         if (root["memory"]) p.memory = root["memory"].as<std::string>("32G");
         if (root["time"]) p.time = root["time"].as<std::string>("4h");
         if (root["output"]) p.output = root["output"].as<std::string>("output/");
+        if (root["compression"]) p.compression = root["compression"].as<std::string>("auto");
+        if (root["atomic-sync"]) p.atomic_sync = root["atomic-sync"].as<bool>(false);
+        if (root["streams"]) p.streams = root["streams"].as<std::string>("auto");
 
         if (root["ports"]) {
             if (root["ports"].IsSequence()) {
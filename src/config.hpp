@@ -5,6 +5,7 @@
 
 Result<Config> load_config(const fs::path& project_dir = fs::current_path());
 Result<GlobalConfig> load_config_global_only();
+fs::path global_config_path();
 Result<void> run_setup();
 
 // Internal helpers (exposed for testing)
@@ -0,0 +1,435 @@
+#include "daemon.hpp"
+#include "config.hpp"
+#include "debug.hpp"
+#include "session.hpp"
+#include "state.hpp"
+#include "sync.hpp"
+#include "theme.hpp"
+#include "wire.hpp"
+#include <fmt/format.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// ── Protocol ──────────────────────────────────────────────
+// Request:  u8 version, u8 op, str project_dir, str arg
+// Replies:  u8 kind + payload, any number of STDOUT/STDERR/STATUS frames
+//           ending in exactly one DONE (i32 exit code) or ERROR (str).
+
+static constexpr uint8_t DAEMON_PROTO = 1;
+static constexpr uint32_t MAX_FRAME = 64u << 20;
+
+enum : uint8_t { OP_EXEC = 1, OP_SYNC = 2, OP_SHUTDOWN = 3 };
+enum : uint8_t { R_STDOUT = 1, R_STDERR = 2, R_STATUS = 3, R_DONE = 4, R_ERROR = 5 };
+
+fs::path daemon_socket_path() {
+    return home_dir() / ".tccp" / "daemon.sock";
+}
+
+#ifdef _WIN32
+// ── Windows stubs (not supported) ────────────────────────
+
+int run_daemon(int) {
+    std::cerr << theme::error("The tccp daemon is not supported on Windows");
+    return 1;
+}
+DaemonClient::~DaemonClient() {}
+bool DaemonClient::connect() { return false; }
+Result<int> DaemonClient::exec(const fs::path&, const std::string&) { return Result<int>::Err("not supported on Windows"); }
+Result<void> DaemonClient::sync(const fs::path&, StatusCallback) { return Result<void>::Err("not supported on Windows"); }
+Result<void> DaemonClient::shutdown() { return Result<void>::Err("not supported on Windows"); }
+Result<int> DaemonClient::request(uint8_t, const fs::path&, const std::string&, StatusCallback) { return Result<int>::Err("not supported on Windows"); }
+
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS: SIGPIPE is ignored process-wide instead
+#endif
+
+static int cloexec(int fd) {
+    if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// ── Framing ───────────────────────────────────────────────
+
+static bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::read(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool write_frame(int fd, const std::string& body) {
+    WireOut hdr;
+    hdr.u32(static_cast<uint32_t>(body.size()));
+    return write_all(fd, hdr.b.data(), hdr.b.size()) && write_all(fd, body.data(), body.size());
+}
+
+static bool read_frame(int fd, std::string& body) {
+    std::string hdr(4, '\0');
+    if (!read_all(fd, hdr.data(), 4)) return false;
+    uint32_t n = WireIn(hdr).u32();
+    if (n > MAX_FRAME) return false;
+    body.resize(n);
+    return n == 0 || read_all(fd, body.data(), n);
+}
+
+static bool send_reply(int fd, uint8_t kind, const char* data, size_t len) {
+    WireOut f;
+    f.u8(kind);
+    f.raw(data, len);
+    return write_frame(fd, f.b);
+}
+
+static bool send_reply(int fd, uint8_t kind, const std::string& data) {
+    return send_reply(fd, kind, data.data(), data.size());
+}
+
+static bool send_done(int fd, int code) {
+    WireOut f;
+    f.u8(R_DONE);
+    f.i32(code);
+    return write_frame(fd, f.b);
+}
+
+// ── Server ────────────────────────────────────────────────
+
+// Re-check the ControlMaster at most this often.
+static constexpr auto MASTER_CHECK_INTERVAL = std::chrono::seconds(60);
+
+static fs::file_time_type mtime_of(const fs::path& p) {
+    std::error_code ec;
+    auto t = fs::last_write_time(p, ec);
+    return ec ? fs::file_time_type::min() : t;
+}
+
+namespace {
+
+// Everything a CLI invocation would build for one project, kept warm.
+struct Project {
+    std::shared_mutex mu;
+    std::unique_ptr<Config> cfg;
+    std::unique_ptr<SSH> ssh;
+    std::unique_ptr<Sync> sync;
+    std::unique_ptr<StateStore> store;
+    std::unique_ptr<Session> session;
+    fs::file_time_type cfg_mtime, global_mtime, state_mtime;
+    std::chrono::steady_clock::time_point master_checked;
+};
+
+class Server {
+public:
+    explicit Server(int idle_minutes) : idle_minutes_(idle_minutes) {}
+    int serve();
+
+private:
+    int idle_minutes_;
+    std::mutex projects_mu_;
+    std::map<std::string, std::unique_ptr<Project>> projects_;
+    std::atomic<int> active_{0};
+    std::atomic<bool> stopping_{false};
+    std::atomic<int64_t> last_activity_{0};
+
+    void handle(int fd);
+    Project& project(const std::string& dir);
+    // Build or refresh p for dir. Caller holds p.mu exclusively.
+    Result<void> prepare(Project& p, const fs::path& dir);
+    void touch();
+};
+
+void Server::touch() {
+    last_activity_ = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Project& Server::project(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(projects_mu_);
+    auto& slot = projects_[dir];
+    if (!slot) slot = std::make_unique<Project>();
+    return *slot;
+}
+
+Result<void> Server::prepare(Project& p, const fs::path& dir) {
+    auto cfg_m = mtime_of(dir / "tccp.yaml");
+    auto global_m = mtime_of(global_config_path());
+    if (!p.cfg || cfg_m != p.cfg_mtime || global_m != p.global_mtime) {
+        auto cfg = load_config(dir);
+        if (cfg.is_err()) return Result<void>::Err(cfg.error);
+        p.session.reset();
+        p.sync.reset();
+        p.store.reset();
+        p.ssh.reset();
+        p.cfg = std::make_unique<Config>(std::move(cfg.value));
+        p.cfg_mtime = cfg_m;
+        p.global_mtime = global_m;
+        debug_log("daemon", fmt::format("loaded config for {}", dir.string()));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!p.ssh || now - p.master_checked > MASTER_CHECK_INTERVAL) {
+        if (!p.ssh) {
+            const auto& g = p.cfg->global;
+            p.ssh = std::make_unique<SSH>(g.host, g.login, g.user, g.password);
+            p.sync = std::make_unique<Sync>(*p.ssh, *p.cfg);
+            p.store = std::make_unique<StateStore>(p.cfg->project_name);
+        }
+        auto conn = p.ssh->connect();
+        if (conn.is_err()) return conn;
+        p.master_checked = now;
+    }
+
+    // Someone ran start/stop without the daemon: pick up the new state.
+    auto state_m = mtime_of(p.store->path());
+    if (!p.session || state_m != p.state_mtime) {
+        p.session = std::make_unique<Session>(*p.cfg, *p.ssh, *p.sync, *p.store);
+        p.state_mtime = state_m;
+    }
+    return Result<void>::Ok();
+}
+
+void Server::handle(int fd) {
+    std::string body;
+    if (!read_frame(fd, body)) return;
+    WireIn in(body);
+    uint8_t version = in.u8();
+    uint8_t op = in.u8();
+    fs::path dir = in.str();
+    std::string arg = in.str();
+    if (in.bad || version != DAEMON_PROTO) {
+        send_reply(fd, R_ERROR, "tccp daemon protocol mismatch; restart it with 'tccp daemon stop'");
+        return;
+    }
+
+    if (op == OP_SHUTDOWN) {
+        stopping_ = true;
+        send_done(fd, 0);
+        return;
+    }
+
+    auto& p = project(dir.string());
+    {
+        std::unique_lock<std::shared_mutex> lock(p.mu);
+        auto ready = prepare(p, dir);
+        if (ready.is_err()) {
+            send_reply(fd, R_ERROR, ready.error);
+            return;
+        }
+    }
+
+    if (op == OP_EXEC) {
+        // Shared: concurrent execs are fine, a reload or sync waits.
+        std::shared_lock<std::shared_mutex> lock(p.mu);
+        bool client_gone = false;
+        ProcIO io;
+        io.on_stdout = [&](const char* d, size_t n) {
+            if (!client_gone && !send_reply(fd, R_STDOUT, d, n)) client_gone = true;
+        };
+        io.on_stderr = [&](const char* d, size_t n) {
+            if (!client_gone && !send_reply(fd, R_STDERR, d, n)) client_gone = true;
+        };
+        // The client sends nothing more; readable means it hung up.
+        io.cancel_fd = fd;
+        auto result = p.session->exec(arg, std::move(io));
+        if (result.is_err()) send_reply(fd, R_ERROR, result.error);
+        else send_done(fd, result.value);
+    } else if (op == OP_SYNC) {
+        std::unique_lock<std::shared_mutex> lock(p.mu);
+        auto result = p.session->sync_files([&](const std::string& msg) {
+            send_reply(fd, R_STATUS, msg);
+        });
+        p.state_mtime = mtime_of(p.store->path());
+        if (result.is_err()) send_reply(fd, R_ERROR, result.error);
+        else send_done(fd, 0);
+    } else {
+        send_reply(fd, R_ERROR, fmt::format("unknown daemon request {}", op));
+    }
+}
+
+int Server::serve() {
+    fs::path path = daemon_socket_path();
+    fs::create_directories(path.parent_path());
+
+    {
+        DaemonClient probe;
+        if (probe.connect()) {
+            std::cerr << theme::error("A tccp daemon is already running");
+            return 1;
+        }
+    }
+    fs::remove(path);  // stale socket from a daemon that didn't exit cleanly
+
+    int lfd = cloexec(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (lfd < 0) {
+        std::cerr << theme::error("socket() failed");
+        return 1;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.string().size() >= sizeof(addr.sun_path)) {
+        close(lfd);
+        std::cerr << theme::error("Daemon socket path too long: " + path.string());
+        return 1;
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // Owner-only: the daemon runs commands with the user's credentials.
+    mode_t old_mask = umask(0077);
+    int rc = bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+    if (rc != 0 || listen(lfd, 16) != 0) {
+        close(lfd);
+        std::cerr << theme::error(fmt::format("Cannot listen on {}: {}", path.string(), std::strerror(errno)));
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    std::cout << theme::ok(fmt::format("tccp daemon listening on {}", path.string()));
+    touch();
+
+    while (!stopping_) {
+        pollfd pfd{lfd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 1000);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) {
+            if (idle_minutes_ > 0 && active_ == 0) {
+                auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                if (now - last_activity_ >= idle_minutes_ * 60) break;
+            }
+            continue;
+        }
+        int cfd = cloexec(accept(lfd, nullptr, nullptr));
+        if (cfd < 0) continue;
+        active_++;
+        touch();
+        std::thread([this, cfd] {
+            handle(cfd);
+            close(cfd);
+            touch();
+            active_--;
+        }).detach();
+    }
+
+    close(lfd);
+    fs::remove(path);
+    // Connection threads reference this object; let them finish.
+    while (active_ > 0) sleep_ms(50);
+    std::cout << theme::ok("tccp daemon stopped");
+    return 0;
+}
+
+} // namespace
+
+int run_daemon(int idle_minutes) {
+    Server server(idle_minutes);
+    return server.serve();
+}
+
+// ── Client ────────────────────────────────────────────────
+
+DaemonClient::~DaemonClient() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool DaemonClient::connect() {
+    const char* off = std::getenv("TCCP_NO_DAEMON");
+    if (off && *off && std::string(off) != "0") return false;
+
+    fs::path path = daemon_socket_path();
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.string().size() >= sizeof(addr.sun_path)) return false;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = cloexec(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+Result<int> DaemonClient::request(uint8_t op, const fs::path& project_dir,
+                                  const std::string& arg, StatusCallback cb) {
+    WireOut req;
+    req.u8(DAEMON_PROTO);
+    req.u8(op);
+    req.str(project_dir.string());
+    req.str(arg);
+    if (fd_ < 0 || !write_frame(fd_, req.b)) {
+        return Result<int>::Err("Cannot reach tccp daemon");
+    }
+
+    std::string frame;
+    while (read_frame(fd_, frame)) {
+        if (frame.empty()) break;
+        uint8_t kind = static_cast<uint8_t>(frame[0]);
+        const char* data = frame.data() + 1;
+        size_t len = frame.size() - 1;
+        switch (kind) {
+            case R_STDOUT: std::cout.write(data, len).flush(); break;
+            case R_STDERR: std::cerr.write(data, len).flush(); break;
+            case R_STATUS: if (cb) cb(std::string(data, len)); break;
+            case R_DONE: {
+                WireIn in(frame);
+                in.u8();
+                return Result<int>::Ok(in.i32());
+            }
+            case R_ERROR: return Result<int>::Err(std::string(data, len));
+            default: break;
+        }
+    }
+    return Result<int>::Err("Lost connection to tccp daemon");
+}
+
+Result<int> DaemonClient::exec(const fs::path& project_dir, const std::string& cmd) {
+    return request(OP_EXEC, project_dir, cmd, nullptr);
+}
+
+Result<void> DaemonClient::sync(const fs::path& project_dir, StatusCallback cb) {
+    auto r = request(OP_SYNC, project_dir, "", cb);
+    if (r.is_err()) return Result<void>::Err(r.error);
+    return Result<void>::Ok();
+}
+
+Result<void> DaemonClient::shutdown() {
+    auto r = request(OP_SHUTDOWN, "", "", nullptr);
+    if (r.is_err()) return Result<void>::Err(r.error);
+    return Result<void>::Ok();
+}
+
+#endif
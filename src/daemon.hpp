@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.hpp"
+#include <string>
+
+// ── Local daemon ──────────────────────────────────────────
+// Optional per-user server on ~/.tccp/daemon.sock. It keeps the parsed
+// config, the ControlMaster check, session state (including the sync
+// manifest) and the remote agents alive between CLI invocations, so a
+// repeated `tccp exec` or `tccp sync` costs one local round trip plus the
+// remote work. Config and session files are re-read only when their mtime
+// changes, so commands run without the daemon stay visible to it.
+//
+// Requests for different projects run in parallel. Within a project, execs
+// run concurrently and a sync waits for them.
+
+fs::path daemon_socket_path();
+
+// Serve until idle for idle_minutes (0 = never) or asked to shut down.
+int run_daemon(int idle_minutes);
+
+class DaemonClient {
+public:
+    DaemonClient() = default;
+    ~DaemonClient();
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    // False when no daemon is listening (or TCCP_NO_DAEMON is set); the
+    // caller then runs the command in-process.
+    bool connect();
+
+    // Output is written to our stdout/stderr as the daemon relays it.
+    Result<int> exec(const fs::path& project_dir, const std::string& cmd);
+    Result<void> sync(const fs::path& project_dir, StatusCallback cb);
+    Result<void> shutdown();
+
+private:
+    int fd_ = -1;
+
+    // Send one request, then dispatch reply frames until DONE or ERROR.
+    Result<int> request(uint8_t op, const fs::path& project_dir,
+                        const std::string& arg, StatusCallback cb);
+};
@@ -0,0 +1,201 @@
+#include "delta.hpp"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr uint32_t ADLER_MOD = 65521;
+
+uint32_t delta_block_size(int64_t size) {
+    auto root = static_cast<uint32_t>(std::sqrt(static_cast<double>(std::max<int64_t>(size, 0))));
+    root = (root + 1023) & ~1023u;
+    return std::clamp<uint32_t>(root, 2048, 128 * 1024);
+}
+
+uint32_t adler32(const unsigned char* p, size_t len) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + p[i]) % ADLER_MOD;
+        b = (b + a) % ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+#ifdef _WIN32
+Result<Delta> make_delta(const fs::path&, const FileSignature&, uint64_t) {
+    return Result<Delta>::Err("delta transfer is not supported on Windows");
+}
+#else
+
+namespace {
+
+// Read-only mapping of a whole file.
+struct Mapped {
+    const unsigned char* p = nullptr;
+    size_t len = 0;
+    ~Mapped() {
+        if (p) munmap(const_cast<unsigned char*>(p), len);
+    }
+};
+
+// Appends instructions, merging consecutive block copies into one run.
+struct Emitter {
+    Delta& d;
+    uint32_t run_first = 0;
+    uint32_t run_count = 0;
+
+    void be32(uint32_t v) {
+        for (int s = 24; s >= 0; s -= 8) d.ops.push_back(static_cast<char>((v >> s) & 0xff));
+    }
+    void flush_run() {
+        if (run_count == 0) return;
+        d.ops.push_back('C');
+        be32(run_first);
+        be32(run_count);
+        run_count = 0;
+    }
+    void copy(uint32_t block) {
+        if (run_count > 0 && block == run_first + run_count) {
+            run_count++;
+            return;
+        }
+        flush_run();
+        run_first = block;
+        run_count = 1;
+    }
+    void literal(const unsigned char* p, size_t n) {
+        if (n == 0) return;
+        flush_run();
+        d.ops.push_back('L');
+        be32(static_cast<uint32_t>(n));
+        d.ops.append(reinterpret_cast<const char*>(p), n);
+        d.literal_bytes += n;
+    }
+};
+
+} // namespace
+
+Result<Delta> make_delta(const fs::path& path, const FileSignature& sig, uint64_t max_literal) {
+    using R = Result<Delta>;
+    if (sig.block_size == 0) return R::Err("empty signature");
+    if (sig.size < 0 ||
+        sig.blocks.size() != (static_cast<uint64_t>(sig.size) + sig.block_size - 1) / sig.block_size) {
+        return R::Err("signature does not cover the file");
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return R::Err("cannot open " + path.string());
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return R::Err("cannot stat " + path.string());
+    }
+    Mapped m;
+    m.len = static_cast<size_t>(st.st_size);
+    if (m.len > 0) {
+        void* p = mmap(nullptr, m.len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            return R::Err("cannot map " + path.string());
+        }
+        m.p = static_cast<const unsigned char*>(p);
+        madvise(p, m.len, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    Delta d;
+    d.size = static_cast<int64_t>(m.len);
+    d.mtime = static_cast<int64_t>(st.st_mtime);
+    Emitter em{d};
+
+    const size_t bs = sig.block_size;
+    const size_t n = m.len;
+    const unsigned char* p = m.p;
+
+    // Only full-size blocks can match the sliding window; a short last
+    // block is tried once against the end of the file.
+    size_t tail_len = static_cast<size_t>(sig.size % static_cast<int64_t>(bs));
+    size_t full_blocks = sig.blocks.size() - (tail_len > 0 && !sig.blocks.empty() ? 1 : 0);
+
+    std::unordered_map<uint32_t, std::vector<uint32_t>> index;
+    std::vector<uint8_t> tag(1 << 16, 0);
+    index.reserve(full_blocks);
+    for (size_t i = 0; i < full_blocks; i++) {
+        uint32_t w = sig.blocks[i].weak;
+        index[w].push_back(static_cast<uint32_t>(i));
+        tag[(w ^ (w >> 16)) & 0xffff] = 1;
+    }
+
+    size_t pos = 0, lit = 0;
+    uint32_t a = 0, b = 0;
+    bool fresh = true;
+    uint32_t hint = UINT32_MAX;  // the block after the last match
+
+    while (pos + bs <= n && !index.empty()) {
+        if (fresh) {
+            uint32_t w = adler32(p + pos, bs);
+            a = w & 0xffff;
+            b = w >> 16;
+            fresh = false;
+        }
+        uint32_t weak = (b << 16) | a;
+        if (tag[(weak ^ (weak >> 16)) & 0xffff]) {
+            auto it = index.find(weak);
+            if (it != index.end()) {
+                auto strong = md5(p + pos, bs);
+                int64_t hit = -1;
+                for (uint32_t idx : it->second) {
+                    if (sig.blocks[idx].strong != strong) continue;
+                    hit = idx;
+                    if (idx == hint) break;
+                }
+                if (hit >= 0) {
+                    em.literal(p + lit, pos - lit);
+                    em.copy(static_cast<uint32_t>(hit));
+                    pos += bs;
+                    lit = pos;
+                    hint = static_cast<uint32_t>(hit) + 1;
+                    fresh = true;
+                    continue;
+                }
+            }
+        }
+
+        if (d.literal_bytes + (pos + 1 - lit) > max_literal) {
+            return R::Err("delta would exceed the literal limit");
+        }
+        if (pos + bs < n) {
+            // Roll the window one byte: drop p[pos], take p[pos + bs]
+            uint32_t out = p[pos], in = p[pos + bs];
+            a = (a + ADLER_MOD - out + in) % ADLER_MOD;
+            uint32_t drop = static_cast<uint32_t>((bs % ADLER_MOD) * out % ADLER_MOD);
+            b = (b + a + 2 * ADLER_MOD - 1 - drop) % ADLER_MOD;
+        }
+        pos++;
+    }
+
+    // Short last block of the remote copy against the end of this file
+    size_t end = n;
+    if (tail_len > 0 && n - lit >= tail_len) {
+        const auto& last = sig.blocks.back();
+        const unsigned char* t = p + n - tail_len;
+        if (adler32(t, tail_len) == last.weak && md5(t, tail_len) == last.strong) {
+            end = n - tail_len;
+        }
+    }
+    em.literal(p + lit, end - lit);
+    if (end < n) em.copy(static_cast<uint32_t>(sig.blocks.size() - 1));
+    em.flush_run();
+
+    if (d.literal_bytes > max_literal) return R::Err("delta would exceed the literal limit");
+    d.md5 = md5(p, n);
+    return R::Ok(std::move(d));
+}
+
+#endif
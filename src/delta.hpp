@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.hpp"
+#include "hash.hpp"
+#include <string>
+#include <vector>
+
+// ── Delta transfer ────────────────────────────────────────
+// rsync's algorithm, for large files the node already has an older copy
+// of. The node agent returns a weak (Adler-32) and a strong (MD5) checksum
+// for each fixed-size block of its copy; we slide a window over the local
+// file with a rolling Adler-32 and turn it into "copy these blocks" and
+// "insert these bytes" instructions. Only the instructions cross the wire;
+// the agent rebuilds the file beside the old one and checks its MD5.
+
+// Files at least this large on both ends go as deltas.
+constexpr int64_t DELTA_MIN_BYTES = 8 << 20;
+
+struct BlockSum {
+    uint32_t weak = 0;
+    MD5::Digest strong{};
+};
+
+struct FileSignature {
+    int64_t size = 0;
+    uint32_t block_size = 0;
+    std::vector<BlockSum> blocks;
+};
+
+// ops is a sequence of 'C' u32 first_block u32 count | 'L' u32 len bytes.
+struct Delta {
+    std::string ops;
+    MD5::Digest md5{};          // whole new file
+    int64_t size = 0;
+    int64_t mtime = 0;          // unix seconds
+    uint64_t literal_bytes = 0;
+};
+
+// About sqrt(size), as rsync picks it, within [2 KiB, 128 KiB].
+uint32_t delta_block_size(int64_t size);
+
+// Same value as zlib.adler32, which the agent uses.
+uint32_t adler32(const unsigned char* p, size_t len);
+
+// Err when the file can't be read, or once the literal data passes
+// max_literal (a whole-file send is then about as cheap).
+Result<Delta> make_delta(const fs::path& path, const FileSignature& sig, uint64_t max_literal);
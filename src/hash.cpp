@@ -0,0 +1,246 @@
+#include "hash.hpp"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// ── XXH64 ─────────────────────────────────────────────────
+// Reference algorithm: https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+static constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Little-endian loads regardless of host byte order.
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * P1 + P4;
+}
+
+XXH64::XXH64(uint64_t seed) : seed_(seed) {
+    v_[0] = seed + P1 + P2;
+    v_[1] = seed + P2;
+    v_[2] = seed;
+    v_[3] = seed - P1;
+}
+
+void XXH64::update(const void* data, size_t len) {
+    auto p = static_cast<const unsigned char*>(data);
+    total_ += len;
+
+    if (buf_len_ + len < 32) {
+        std::memcpy(buf_ + buf_len_, p, len);
+        buf_len_ += len;
+        return;
+    }
+    if (buf_len_ > 0) {
+        size_t fill = 32 - buf_len_;
+        std::memcpy(buf_ + buf_len_, p, fill);
+        for (int i = 0; i < 4; i++) v_[i] = round(v_[i], read64(buf_ + 8 * i));
+        p += fill;
+        len -= fill;
+        buf_len_ = 0;
+    }
+    while (len >= 32) {
+        for (int i = 0; i < 4; i++) v_[i] = round(v_[i], read64(p + 8 * i));
+        p += 32;
+        len -= 32;
+    }
+    std::memcpy(buf_, p, len);
+    buf_len_ = len;
+}
+
+uint64_t XXH64::digest() const {
+    uint64_t h;
+    if (total_ >= 32) {
+        h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+        for (int i = 0; i < 4; i++) h = merge_round(h, v_[i]);
+    } else {
+        h = seed_ + P5;
+    }
+    h += total_;
+
+    const unsigned char* p = buf_;
+    size_t len = buf_len_;
+    while (len >= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * P5;
+        h = rotl(h, 11) * P1;
+        p++;
+        len--;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64(const void* data, size_t len, uint64_t seed) {
+    XXH64 s(seed);
+    s.update(data, len);
+    return s.digest();
+}
+
+// ── MD5 ───────────────────────────────────────────────────
+// RFC 1321.
+
+static const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const int MD5_R[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static inline uint32_t rotl32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+MD5::MD5() {
+    s_[0] = 0x67452301;
+    s_[1] = 0xefcdab89;
+    s_[2] = 0x98badcfe;
+    s_[3] = 0x10325476;
+}
+
+void MD5::block(const unsigned char* p) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) m[i] = read32(p + 4 * i);
+    uint32_t a = s_[0], b = s_[1], c = s_[2], d = s_[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+        else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+        else if (i < 48) { f = b ^ c ^ d;          g = (3 * i + 5) % 16; }
+        else             { f = c ^ (b | ~d);       g = (7 * i) % 16; }
+        uint32_t t = d;
+        d = c;
+        c = b;
+        b = b + rotl32(a + f + MD5_K[i] + m[g], MD5_R[i]);
+        a = t;
+    }
+    s_[0] += a;
+    s_[1] += b;
+    s_[2] += c;
+    s_[3] += d;
+}
+
+void MD5::update(const void* data, size_t len) {
+    auto p = static_cast<const unsigned char*>(data);
+    total_ += len;
+    if (buf_len_ > 0) {
+        size_t fill = std::min(len, 64 - buf_len_);
+        std::memcpy(buf_ + buf_len_, p, fill);
+        buf_len_ += fill;
+        p += fill;
+        len -= fill;
+        if (buf_len_ < 64) return;
+        block(buf_);
+        buf_len_ = 0;
+    }
+    while (len >= 64) {
+        block(p);
+        p += 64;
+        len -= 64;
+    }
+    std::memcpy(buf_, p, len);
+    buf_len_ = len;
+}
+
+MD5::Digest MD5::digest() const {
+    MD5 t = *this;
+    uint64_t bits = total_ * 8;
+    unsigned char pad[72] = {0x80};
+    size_t pad_len = (buf_len_ < 56 ? 56 : 120) - buf_len_;
+    t.update(pad, pad_len);
+    unsigned char len_le[8];
+    for (int i = 0; i < 8; i++) len_le[i] = static_cast<unsigned char>(bits >> (8 * i));
+    t.update(len_le, 8);
+
+    Digest out;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) out[4 * i + j] = static_cast<uint8_t>(t.s_[i] >> (8 * j));
+    }
+    return out;
+}
+
+MD5::Digest md5(const void* data, size_t len) {
+    MD5 s;
+    s.update(data, len);
+    return s.digest();
+}
+
+// ── Files ─────────────────────────────────────────────────
+
+Result<uint64_t> hash_file(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return Result<uint64_t>::Err("cannot open " + path.string());
+    XXH64 s;
+    std::string buf(256 * 1024, '\0');
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        auto n = in.gcount();
+        if (n > 0) s.update(buf.data(), static_cast<size_t>(n));
+    }
+    if (in.bad()) return Result<uint64_t>::Err("read error on " + path.string());
+    return Result<uint64_t>::Ok(s.digest());
+}
+
+std::string hash_hex(uint64_t h) {
+    return fmt::format("{:016x}", h);
+}
+
+uint64_t parse_hash_hex(const std::string& s) {
+    if (s.size() != 16) return 0;
+    try {
+        size_t used = 0;
+        uint64_t v = std::stoull(s, &used, 16);
+        return used == s.size() ? v : 0;
+    } catch (...) {
+        return 0;
+    }
+}
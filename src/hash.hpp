@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+
+// ── Content hashing ───────────────────────────────────────
+// XXH64 (Yann Collet's xxHash, 64-bit variant), implemented in-tree so the
+// build needs no extra dependency. Non-cryptographic: used only to tell
+// whether a file's bytes changed, never for integrity against tampering.
+
+class XXH64 {
+public:
+    explicit XXH64(uint64_t seed = 0);
+    void update(const void* data, size_t len);
+    uint64_t digest() const;
+
+private:
+    uint64_t v_[4];
+    uint64_t seed_;
+    uint64_t total_ = 0;
+    unsigned char buf_[32];
+    size_t buf_len_ = 0;
+};
+
+uint64_t xxh64(const void* data, size_t len, uint64_t seed = 0);
+
+// MD5, only as the strong block checksum for delta transfer: the remote
+// agent has it in Python's hashlib without extra modules.
+class MD5 {
+public:
+    using Digest = std::array<uint8_t, 16>;
+    MD5();
+    void update(const void* data, size_t len);
+    Digest digest() const;
+
+private:
+    uint32_t s_[4];
+    uint64_t total_ = 0;
+    unsigned char buf_[64];
+    size_t buf_len_ = 0;
+    void block(const unsigned char* p);
+};
+
+MD5::Digest md5(const void* data, size_t len);
+
+// Hash of a file's contents.
+Result<uint64_t> hash_file(const fs::path& path);
+
+// 16 lowercase hex digits, and back (0 on malformed input).
+std::string hash_hex(uint64_t h);
+uint64_t parse_hash_hex(const std::string& s);
@@ -0,0 +1,305 @@
+#include "ignore.hpp"
+#include <algorithm>
+#include <array>
+#include <deque>
+
+// ── Patterns ──────────────────────────────────────────────
+
+void IgnoreMatcher::add(const std::string& raw, bool negation) {
+    Pattern pat;
+    pat.raw = raw;
+    pat.is_negation = negation;
+    pat.is_dir = !raw.empty() && raw.back() == '/';
+    pat.has_glob = raw.find('*') != std::string::npos || raw.find('?') != std::string::npos;
+    if (pat.has_glob) {
+        try {
+            pat.compiled = std::regex(glob_to_regex(raw));
+        } catch (...) {
+            pat.has_glob = false;
+        }
+    }
+    pat.name = pat.is_dir ? raw.substr(0, raw.size() - 1) : raw;
+    pat.slash_name = "/" + pat.name;
+    pat.name_slash = pat.name + "/";
+    patterns_.push_back(std::move(pat));
+}
+
+void IgnoreMatcher::force_include(std::string rel) {
+    while (!rel.empty() && rel.back() == '/') rel.pop_back();
+    std::replace(rel.begin(), rel.end(), '\\', '/');
+    force_.push_back(std::move(rel));
+}
+
+std::string IgnoreMatcher::glob_to_regex(const std::string& glob) {
+    std::string regex;
+    bool escape = false;
+
+    for (size_t i = 0; i < glob.length(); ++i) {
+        char c = glob[i];
+        if (escape) {
+            regex += c;
+            escape = false;
+        } else if (c == '\\') {
+            escape = true;
+        } else if (c == '*') {
+            if (i + 1 < glob.length() && glob[i + 1] == '*') {
+                regex += ".*";
+                i++;
+            } else {
+                regex += "[^/]*";
+            }
+        } else if (c == '?') {
+            regex += "[^/]";
+        } else if (c == '.') {
+            regex += "\\.";
+        } else if (c == '[') {
+            regex += '[';
+        } else if (c == ']') {
+            regex += ']';
+        } else {
+            regex += c;
+        }
+    }
+    return regex;
+}
+
+// ── Compilation ───────────────────────────────────────────
+
+namespace {
+
+// Longest run of characters that the glob's regex matches literally, or ""
+// if the glob passes regex syntax through (escapes, groups, anchors, ...).
+// Runs break at wildcards and bracket expressions.
+std::string required_literal(const std::string& glob) {
+    if (glob.find_first_of("\\+{}()|^$") != std::string::npos) return "";
+    std::string best, run;
+    bool in_bracket = false;
+    for (char c : glob) {
+        if (in_bracket) {
+            if (c == ']') in_bracket = false;
+            continue;
+        }
+        if (c == '*' || c == '?' || c == '[' || c == ']') {
+            if (run.size() > best.size()) best = run;
+            run.clear();
+            in_bracket = c == '[';
+            continue;
+        }
+        run += c;
+    }
+    if (run.size() > best.size()) best = run;
+    return best;
+}
+
+// For a glob of literals and stars only, the part between the outer
+// stars if no star is left inside it.
+bool star_core(const std::string& glob, std::string& core) {
+    if (glob.find_first_of("\\+{}()|^$?[]") != std::string::npos) return false;
+    size_t b = glob.find_first_not_of('*');
+    if (b == std::string::npos) {
+        core.clear();
+        return true;
+    }
+    size_t e = glob.find_last_not_of('*');
+    core = glob.substr(b, e - b + 1);
+    return core.find('*') == std::string::npos;
+}
+
+} // namespace
+
+void IgnoreMatcher::compile() {
+    struct Needle {
+        std::string text;
+        Output out;
+    };
+    std::vector<Needle> needles;
+    const std::string nul(1, '\0');
+    always_match_ = -1;
+    always_check_.clear();
+
+    for (uint32_t i = 0; i < patterns_.size(); i++) {
+        const auto& p = patterns_[i];
+        if (!p.has_glob) {
+            if (p.is_dir) {
+                needles.push_back({nul + p.name + nul, {i, Hit::Match}});
+                needles.push_back({nul + p.name_slash, {i, Hit::Match}});
+            } else if (p.raw == "*") {
+                always_match_ = i;
+            } else {
+                needles.push_back({nul + p.raw + nul, {i, Hit::Match}});
+                needles.push_back({p.slash_name, {i, Hit::Match}});
+            }
+            continue;
+        }
+        std::string core;
+        if (star_core(p.raw, core)) {
+            if (core.empty()) always_match_ = i;
+            else needles.push_back({core, {i, Hit::Match}});
+            continue;
+        }
+        std::string lit = required_literal(p.raw);
+        if (lit.empty()) always_check_.push_back(i);
+        else needles.push_back({lit, {i, Hit::Candidate}});
+    }
+    for (const auto& f : force_) {
+        if (f.empty()) continue;
+        needles.push_back({nul + f + nul, {0, Hit::Force}});
+        needles.push_back({nul + f + "/", {0, Hit::Force}});
+    }
+
+    // Trie, then breadth-first failure links folded into a full DFA
+    next_.assign(256, -1);
+    out_.assign(1, {});
+    for (const auto& n : needles) {
+        int32_t s = 0;
+        for (unsigned char c : n.text) {
+            int32_t& t = next_[static_cast<size_t>(s) * 256 + c];
+            if (t < 0) {
+                t = static_cast<int32_t>(out_.size());
+                out_.emplace_back();
+                next_.resize(next_.size() + 256, -1);
+            }
+            s = next_[static_cast<size_t>(s) * 256 + c];
+        }
+        out_[s].push_back(n.out);
+    }
+
+    std::vector<int32_t> fail(out_.size(), 0);
+    std::deque<int32_t> queue;
+    for (int c = 0; c < 256; c++) {
+        int32_t& t = next_[c];
+        if (t < 0) {
+            t = 0;
+        } else {
+            fail[t] = 0;
+            queue.push_back(t);
+        }
+    }
+    while (!queue.empty()) {
+        int32_t s = queue.front();
+        queue.pop_front();
+        const auto& inherited = out_[fail[s]];
+        out_[s].insert(out_[s].end(), inherited.begin(), inherited.end());
+        for (int c = 0; c < 256; c++) {
+            size_t slot = static_cast<size_t>(s) * 256 + c;
+            int32_t via_fail = next_[static_cast<size_t>(fail[s]) * 256 + c];
+            if (next_[slot] < 0) {
+                next_[slot] = via_fail;
+            } else {
+                fail[next_[slot]] = via_fail;
+                queue.push_back(next_[slot]);
+            }
+        }
+    }
+}
+
+// ── Matching ──────────────────────────────────────────────
+
+IgnoreMatcher::Verdict IgnoreMatcher::verdict(int64_t best) const {
+    if (best < 0) return Verdict::None;
+    return patterns_[static_cast<size_t>(best)].is_negation ? Verdict::Kept : Verdict::Ignored;
+}
+
+IgnoreMatcher::Verdict IgnoreMatcher::match(const std::string& rel) const {
+    if (next_.empty()) return match_linear(rel);
+
+    thread_local std::vector<uint32_t> candidates;
+    candidates.clear();
+    int64_t best = always_match_;
+
+    // Returns true on a force-include, which overrides everything
+    auto visit = [&](int32_t s) {
+        for (const auto& o : out_[s]) {
+            if (o.hit == Hit::Force) return true;
+            if (o.hit == Hit::Match) best = std::max<int64_t>(best, o.pattern);
+            else candidates.push_back(o.pattern);
+        }
+        return false;
+    };
+
+    int32_t s = next_[0];
+    if (!out_[s].empty() && visit(s)) return Verdict::Forced;
+    for (unsigned char c : rel) {
+        s = next_[static_cast<size_t>(s) * 256 + c];
+        if (!out_[s].empty() && visit(s)) return Verdict::Forced;
+    }
+    s = next_[static_cast<size_t>(s) * 256];
+    if (!out_[s].empty() && visit(s)) return Verdict::Forced;
+
+    candidates.insert(candidates.end(), always_check_.begin(), always_check_.end());
+    std::sort(candidates.begin(), candidates.end(), std::greater<uint32_t>());
+    for (uint32_t c : candidates) {
+        if (static_cast<int64_t>(c) <= best) break;
+        if (std::regex_search(rel, patterns_[c].compiled)) {
+            best = c;
+            break;
+        }
+    }
+    return verdict(best);
+}
+
+IgnoreMatcher::Verdict IgnoreMatcher::match_linear(const std::string& rel) const {
+    if (is_force_included(rel)) return Verdict::Forced;
+    int64_t best = -1;
+    for (size_t i = 0; i < patterns_.size(); i++) {
+        if (matches_pattern(rel, patterns_[i])) best = static_cast<int64_t>(i);
+    }
+    return verdict(best);
+}
+
+bool IgnoreMatcher::is_force_included(const std::string& rel) const {
+    for (const auto& fi : force_) {
+        if (fi.empty()) continue;
+        if (rel == fi) return true;
+        if (rel.size() > fi.size() && rel.compare(0, fi.size(), fi) == 0
+            && rel[fi.size()] == '/') return true;
+    }
+    return false;
+}
+
+bool IgnoreMatcher::matches_pattern(const std::string& path, const Pattern& pat) const {
+    if (pat.has_glob) {
+        return std::regex_search(path, pat.compiled);
+    }
+
+    if (pat.raw == "*") return true;
+
+    if (pat.is_dir) {
+        return path == pat.name || path.compare(0, pat.name_slash.size(), pat.name_slash) == 0;
+    }
+
+    return path == pat.raw || path.find(pat.slash_name) != std::string::npos;
+}
+
+bool IgnoreMatcher::is_forced(const std::string& rel, bool dir) const {
+    if (is_force_included(rel)) return true;
+    if (!dir) return false;
+    for (const auto& fi : force_) {
+        if (fi.size() > rel.size() && fi.compare(0, rel.size(), rel) == 0
+            && fi[rel.size()] == '/') return true;
+    }
+    return false;
+}
+
+IgnoreMatcher::Verdict IgnoreMatcher::dir_match(const std::string& rel_dir) const {
+    if (is_forced(rel_dir, true)) return Verdict::Forced;
+    Verdict v = Verdict::None;
+    for (const auto& pat : patterns_) {
+        if (pat.is_negation) {
+            if (matches_pattern(rel_dir, pat)) v = Verdict::Kept;
+            continue;
+        }
+        if (pat.is_dir) {
+            if (rel_dir == pat.name || rel_dir.compare(0, pat.name_slash.size(), pat.name_slash) == 0 ||
+                rel_dir.find(pat.slash_name) != std::string::npos) {
+                v = Verdict::Ignored;
+            }
+        }
+        if (!pat.is_dir && !pat.has_glob) {
+            if (rel_dir == pat.raw || rel_dir.find(pat.slash_name) != std::string::npos) {
+                v = Verdict::Ignored;
+            }
+        }
+    }
+    return v;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <vector>
+
+// ── Ignore matching ───────────────────────────────────────
+// Every pattern of an ignore set (built-in defaults, the ignore file,
+// negations, rodata force-includes) compiled into one Aho-Corasick
+// automaton, so a path is classified in a single pass over its bytes.
+// The path is framed by NUL bytes, which turns anchored rules into plain
+// needles:
+//   name          "/name" anywhere, or the whole path "\0name\0"
+//   dir/          the whole path "\0dir\0", or the prefix "\0dir/"
+//   *.ext, **/x/* the literal core ".ext", "/x/" anywhere: globs are an
+//                 unanchored search, so outer stars only match ""
+// Globs with inner wildcards keep their regex. It runs only once the
+// automaton has seen the glob's longest literal, and only if the pattern
+// could still beat the best match so far (last match wins).
+
+class IgnoreMatcher {
+public:
+    enum class Verdict { None, Ignored, Kept, Forced };
+
+    // Patterns in file order; a later match overrides an earlier one.
+    void add(const std::string& raw, bool negation);
+    // rel and everything under it are never ignored.
+    void force_include(std::string rel);
+    // Build the automaton; call after the last add.
+    void compile();
+    bool empty() const { return patterns_.empty() && force_.empty(); }
+
+    // rel is relative to the ignore file's directory, '/'-separated.
+    Verdict match(const std::string& rel) const;
+    bool is_ignored(const std::string& rel) const { return match(rel) == Verdict::Ignored; }
+    // Whether the walk may skip a directory entirely.
+    Verdict dir_match(const std::string& rel_dir) const;
+    bool is_dir_ignored(const std::string& rel_dir) const {
+        return dir_match(rel_dir) == Verdict::Ignored;
+    }
+    // rel is force-included, or (for a directory) something below it is.
+    bool is_forced(const std::string& rel, bool dir) const;
+
+    // The per-pattern loop the automaton replaces. Kept as the reference
+    // tccp-bench checks and times it against.
+    Verdict match_linear(const std::string& rel) const;
+
+    static std::string glob_to_regex(const std::string& glob);
+
+private:
+    struct Pattern {
+        std::string raw;
+        bool is_negation = false;
+        bool is_dir = false;
+        bool has_glob = false;
+        std::regex compiled;
+        std::string name;        // raw without a trailing '/'
+        std::string slash_name;  // "/" + name
+        std::string name_slash;  // name + "/"
+    };
+
+    enum class Hit : uint8_t { Match, Candidate, Force };
+    struct Output {
+        uint32_t pattern;
+        Hit hit;
+    };
+
+    std::vector<Pattern> patterns_;
+    std::vector<std::string> force_;
+
+    std::vector<int32_t> next_;               // state * 256 + byte → state
+    std::vector<std::vector<Output>> out_;    // per state, including suffix matches
+    int64_t always_match_ = -1;               // last pattern matching every path
+    std::vector<uint32_t> always_check_;      // regex globs with no usable literal
+
+    bool is_force_included(const std::string& rel) const;
+    bool matches_pattern(const std::string& path, const Pattern& pat) const;
+    Verdict verdict(int64_t best) const;
+};
@@ -1,4 +1,5 @@
 #include "config.hpp"
+#include "daemon.hpp"
 #include "ssh.hpp"
 #include "sync.hpp"
 #include "session.hpp"
@@ -12,6 +13,11 @@
 #include <map>
 #include <set>
 #include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 static StatusCallback make_cb() {
     return [](const std::string& msg) {
@@ -41,6 +47,34 @@ static int run_with_session(const std::function<int(Session&)>& fn) {
     return fn(session);
 }
 
+// ── Ctrl-C as a readable fd ───────────────────────────────
+// For loops that poll(): SIGINT writes to a pipe instead of killing us,
+// so they can finish what they're doing and save state.
+
+#ifndef _WIN32
+static int g_stop_pipe[2] = {-1, -1};
+
+static void on_stop_signal(int) {
+    char c = 1;
+    (void)!write(g_stop_pipe[1], &c, 1);
+}
+#endif
+
+static int stop_fd_on_sigint() {
+#ifdef _WIN32
+    return -1;
+#else
+    if (pipe(g_stop_pipe) != 0) return -1;
+    fcntl(g_stop_pipe[1], F_SETFL, O_NONBLOCK);
+    struct sigaction sa {};
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    return g_stop_pipe[0];
+#endif
+}
+
 // ── GPU info (static, no SSH) ─────────────────────────────
 
 static void show_gpu_guide() {
@@ -354,6 +388,16 @@ int main(int argc, char** argv) {
             if (i > 0) cmd += " ";
             cmd += exec_args[i];
         }
+        // Thin client when a daemon is running
+        DaemonClient daemon;
+        if (daemon.connect()) {
+            auto result = daemon.exec(fs::current_path(), cmd);
+            if (result.is_err()) {
+                std::cerr << theme::error(result.error);
+                std::exit(1);
+            }
+            std::exit(result.value);
+        }
         int rc = run_with_session([&cmd](Session& s) {
             auto result = s.exec(cmd);
             if (result.is_err()) {
@@ -366,8 +410,30 @@ int main(int argc, char** argv) {
     });
 
     // ── sync ──────────────────────────────────────────────
+    bool sync_watch = false;
     auto* sync_cmd = app.add_subcommand("sync", "Sync files with compute node");
+    sync_cmd->add_flag("--watch,-w", sync_watch, "Keep syncing as files change (until Ctrl-C)");
     sync_cmd->callback([&]() {
+        if (sync_watch) {
+            int rc = run_with_session([](Session& s) {
+                auto result = s.watch(make_cb(), stop_fd_on_sigint());
+                if (result.is_err()) {
+                    std::cerr << theme::error(result.error);
+                    return 1;
+                }
+                return 0;
+            });
+            std::exit(rc);
+        }
+        DaemonClient daemon;
+        if (daemon.connect()) {
+            auto result = daemon.sync(fs::current_path(), make_cb());
+            if (result.is_err()) {
+                std::cerr << theme::error(result.error);
+                std::exit(1);
+            }
+            std::exit(0);
+        }
         int rc = run_with_session([](Session& s) {
             auto result = s.sync_files(make_cb());
             if (result.is_err()) {
@@ -379,6 +445,34 @@ int main(int argc, char** argv) {
         std::exit(rc);
     });
 
+    // ── daemon ────────────────────────────────────────────
+    std::string daemon_action;
+    int daemon_idle = 30;
+    auto* daemon_cmd = app.add_subcommand("daemon", "Run the local daemon that keeps exec/sync warm");
+    daemon_cmd->add_option("action", daemon_action, "'stop' to shut down a running daemon");
+    daemon_cmd->add_option("--idle", daemon_idle, "Exit after this many idle minutes (0 = never)");
+    daemon_cmd->callback([&]() {
+        if (daemon_action == "stop") {
+            DaemonClient daemon;
+            if (!daemon.connect()) {
+                std::cout << theme::ok("No tccp daemon running.");
+                std::exit(0);
+            }
+            auto result = daemon.shutdown();
+            if (result.is_err()) {
+                std::cerr << theme::error(result.error);
+                std::exit(1);
+            }
+            std::cout << theme::ok("tccp daemon stopping.");
+            std::exit(0);
+        }
+        if (!daemon_action.empty()) {
+            std::cerr << theme::error(fmt::format("Unknown daemon action '{}'", daemon_action));
+            std::exit(1);
+        }
+        std::exit(run_daemon(daemon_idle));
+    });
+
     // ── status ────────────────────────────────────────────
     auto* status_cmd = app.add_subcommand("status", "Show session info");
     status_cmd->callback([&]() {
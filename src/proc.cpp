@@ -0,0 +1,577 @@
+#include "proc.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+// ── LineSplitter ──────────────────────────────────────────
+
+void LineSplitter::feed(const char* data, size_t len) {
+    while (len > 0) {
+        const char* nl = static_cast<const char*>(std::memchr(data, '\n', len));
+        size_t take = nl ? static_cast<size_t>(nl - data) : len;
+        if (partial_.size() + take > max_line_) {
+            take = max_line_ - partial_.size();
+            partial_.append(data, take);
+            on_line_(partial_);
+            partial_.clear();
+        } else if (nl) {
+            partial_.append(data, take);
+            if (!partial_.empty() && partial_.back() == '\r') partial_.pop_back();
+            on_line_(partial_);
+            partial_.clear();
+            take++;  // consume the newline
+        } else {
+            partial_.append(data, take);
+        }
+        data += take;
+        len -= take;
+    }
+}
+
+void LineSplitter::flush() {
+    if (partial_.empty()) return;
+    on_line_(partial_);
+    partial_.clear();
+}
+
+#ifdef _WIN32
+// ── Windows stubs (not supported) ────────────────────────
+
+Process::~Process() {}
+Result<void> Process::spawn(const std::vector<std::string>&, bool) { return Result<void>::Err("not supported on Windows"); }
+ProcStatus Process::pump(const ProcIO&, int) { return {-1, false, "not supported on Windows"}; }
+void Process::terminate() {}
+bool Process::poll_exit() { return true; }
+void Process::close_stdin() {}
+bool Process::wait_exit_for(int) { return true; }
+void Process::close_fds() {}
+int Process::exit_code() const { return -1; }
+ProcStatus run_process(const std::vector<std::string>&, const ProcIO&, int) { return {-1, false, "not supported on Windows"}; }
+RelayStatus run_relay(const std::vector<std::string>&, const std::vector<std::string>&, int) {
+    RelayStatus st;
+    st.producer.error = st.consumer.error = "not supported on Windows";
+    return st;
+}
+RelayStatus run_from_writer(const StreamWriter&, const std::vector<std::string>&, const std::vector<std::string>&, int) {
+    RelayStatus st;
+    st.producer.error = st.consumer.error = "not supported on Windows";
+    return st;
+}
+RelayStatus run_to_reader(const std::vector<std::string>&, const std::string&, const std::vector<std::string>&, const StreamReader&, int) {
+    RelayStatus st;
+    st.producer.error = st.consumer.error = "not supported on Windows";
+    return st;
+}
+
+#else
+
+// Fallback wake-up interval when no pidfd is available (macOS, old kernels).
+static constexpr int EXIT_POLL_MS = 10;
+
+static bool make_pipe(int fds[2]) {
+#ifdef __linux__
+    // Atomic CLOEXEC: another thread forking between pipe() and fcntl()
+    // would otherwise leak our write end into its child.
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void close_fd(int& fd) {
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+static int open_pidfd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    int fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// Read everything currently available. Returns false once the fd hit EOF/error.
+static bool drain_fd(int fd, const OutputSink& sink) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            if (sink) sink(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false;
+    }
+}
+
+// ── Process ───────────────────────────────────────────────
+
+Process::~Process() {
+    if (running()) terminate();
+    close_fds();
+}
+
+void Process::close_fds() {
+    close_fd(in_fd_);
+    close_fd(out_fd_);
+    close_fd(err_fd_);
+    close_fd(pid_fd_);
+}
+
+void Process::close_stdin() {
+    close_fd(in_fd_);
+}
+
+Result<void> Process::spawn(const std::vector<std::string>& args, bool pipe_stdin) {
+    int in_pipe[2] = {-1, -1}, out_pipe[2], err_pipe[2];
+    if (!make_pipe(out_pipe)) return Result<void>::Err("pipe() failed");
+    if (!make_pipe(err_pipe)) {
+        close(out_pipe[0]); close(out_pipe[1]);
+        return Result<void>::Err("pipe() failed");
+    }
+    if (pipe_stdin && !make_pipe(in_pipe)) {
+        close(out_pipe[0]); close(out_pipe[1]);
+        close(err_pipe[0]); close(err_pipe[1]);
+        return Result<void>::Err("pipe() failed");
+    }
+    if (pipe_stdin) {
+        // A child that exits early must surface as EPIPE, not kill us.
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        for (int fd : {in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]})
+            if (fd >= 0) close(fd);
+        return Result<void>::Err("fork() failed");
+    }
+
+    if (pid == 0) {
+        if (pipe_stdin) {
+            dup2(in_pipe[0], STDIN_FILENO);
+            signal(SIGPIPE, SIG_DFL);
+        }
+        dup2(out_pipe[1], STDOUT_FILENO);
+        dup2(err_pipe[1], STDERR_FILENO);
+
+        std::vector<const char*> argv;
+        for (const auto& a : args) argv.push_back(a.c_str());
+        argv.push_back(nullptr);
+
+        execvp(argv[0], const_cast<char* const*>(argv.data()));
+        _exit(127);
+    }
+
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    out_fd_ = out_pipe[0];
+    err_fd_ = err_pipe[0];
+    set_nonblocking(out_fd_);
+    set_nonblocking(err_fd_);
+    if (pipe_stdin) {
+        close(in_pipe[0]);
+        in_fd_ = in_pipe[1];
+        set_nonblocking(in_fd_);
+    }
+
+    pid_ = pid;
+    exited_ = false;
+    pid_fd_ = open_pidfd(pid);
+    return Result<void>::Ok();
+}
+
+bool Process::poll_exit() {
+    if (pid_ <= 0 || exited_) return true;
+    int ret;
+    do {
+        ret = waitpid(pid_, &status_, WNOHANG);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == pid_ || (ret < 0 && errno == ECHILD)) exited_ = true;
+    return exited_;
+}
+
+bool Process::wait_exit_for(int ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!poll_exit()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        if (pid_fd_ >= 0) {
+            pollfd p{pid_fd_, POLLIN, 0};
+            poll(&p, 1, static_cast<int>(left));
+        } else {
+            poll(nullptr, 0, static_cast<int>(std::min<long long>(left, EXIT_POLL_MS)));
+        }
+    }
+    return true;
+}
+
+void Process::terminate() {
+    if (!running()) return;
+    kill(pid_, SIGTERM);
+    if (!wait_exit_for(500)) {
+        kill(pid_, SIGKILL);
+        while (waitpid(pid_, &status_, 0) < 0 && errno == EINTR) {}
+        exited_ = true;
+    }
+}
+
+int Process::exit_code() const {
+    return WIFEXITED(status_) ? WEXITSTATUS(status_) : -1;
+}
+
+ProcStatus Process::pump(const ProcIO& io, int timeout) {
+    ProcStatus st;
+    if (pid_ <= 0) {
+        st.error = "process not started";
+        return st;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::seconds(timeout);
+
+    // Pending stdin bytes not yet accepted by the pipe.
+    std::string in_buf;
+    size_t in_off = 0;
+    bool in_eof = !io.stdin_source;
+    if (in_eof && in_fd_ >= 0) close_stdin();
+
+    while (true) {
+        if (poll_exit()) break;
+
+        // Refill stdin buffer from the producer.
+        if (in_fd_ >= 0 && in_off == in_buf.size() && !in_eof) {
+            in_buf.resize(256 * 1024);
+            ssize_t n = io.stdin_source(in_buf.data(), in_buf.size());
+            if (n < 0) {
+                st.error = "stdin source failed";
+                terminate();
+                close_fds();
+                return st;
+            }
+            in_buf.resize(static_cast<size_t>(n));
+            in_off = 0;
+            if (n == 0) in_eof = true;
+        }
+        if (in_fd_ >= 0 && in_eof && in_off == in_buf.size()) close_stdin();
+
+        pollfd fds[5];
+        int nfds = 0, i_out = -1, i_err = -1, i_in = -1, i_pid = -1, i_cancel = -1;
+        if (out_fd_ >= 0) { i_out = nfds; fds[nfds++] = {out_fd_, POLLIN, 0}; }
+        if (err_fd_ >= 0) { i_err = nfds; fds[nfds++] = {err_fd_, POLLIN, 0}; }
+        if (in_fd_ >= 0) { i_in = nfds; fds[nfds++] = {in_fd_, POLLOUT, 0}; }
+        if (pid_fd_ >= 0) { i_pid = nfds; fds[nfds++] = {pid_fd_, POLLIN, 0}; }
+        if (io.cancel_fd >= 0) { i_cancel = nfds; fds[nfds++] = {io.cancel_fd, POLLIN, 0}; }
+
+        int wait_ms = -1;
+        if (timeout > 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock::now()).count();
+            if (left <= 0) {
+                terminate();
+                close_fds();
+                st.timed_out = true;
+                st.error = "command timed out";
+                return st;
+            }
+            wait_ms = static_cast<int>(left);
+        }
+        // Without a pidfd we cannot sleep on the exit itself once the pipes
+        // are gone (or held open by a backgrounded grandchild).
+        if (pid_fd_ < 0 && (wait_ms < 0 || wait_ms > EXIT_POLL_MS)) {
+            wait_ms = EXIT_POLL_MS;
+        }
+
+        int ready = poll(fds, static_cast<nfds_t>(nfds), wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            st.error = "poll() failed";
+            terminate();
+            close_fds();
+            return st;
+        }
+
+        if (i_cancel >= 0 && fds[i_cancel].revents) {
+            terminate();
+            close_fds();
+            st.error = "cancelled";
+            return st;
+        }
+        if (i_out >= 0 && fds[i_out].revents) {
+            if (!drain_fd(out_fd_, io.on_stdout)) close_fd(out_fd_);
+        }
+        if (i_err >= 0 && fds[i_err].revents) {
+            if (!drain_fd(err_fd_, io.on_stderr)) close_fd(err_fd_);
+        }
+        if (i_in >= 0 && fds[i_in].revents) {
+            if (fds[i_in].revents & (POLLERR | POLLHUP)) {
+                // Reader went away; stop feeding.
+                close_stdin();
+                in_eof = true;
+            } else {
+                while (in_off < in_buf.size()) {
+                    ssize_t n = write(in_fd_, in_buf.data() + in_off, in_buf.size() - in_off);
+                    if (n > 0) { in_off += static_cast<size_t>(n); continue; }
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    close_stdin();
+                    in_eof = true;
+                    break;
+                }
+            }
+        }
+        (void)i_pid;  // exit is picked up by poll_exit() at the top of the loop
+    }
+
+    // Child is gone: collect whatever it left in the pipes, but don't wait
+    // for EOF — a backgrounded grandchild may hold the write ends forever.
+    if (out_fd_ >= 0) drain_fd(out_fd_, io.on_stdout);
+    if (err_fd_ >= 0) drain_fd(err_fd_, io.on_stderr);
+    close_fds();
+
+    st.exit_code = exit_code();
+    return st;
+}
+
+ProcStatus run_process(const std::vector<std::string>& args, const ProcIO& io, int timeout) {
+    Process p;
+    auto sp = p.spawn(args, static_cast<bool>(io.stdin_source));
+    if (sp.is_err()) {
+        ProcStatus st;
+        st.error = sp.error;
+        return st;
+    }
+    return p.pump(io, timeout);
+}
+
+// ── Relay ─────────────────────────────────────────────────
+
+// Cap on collected stderr so a chatty child can't grow us without bound.
+static constexpr size_t RELAY_ERR_MAX = 64 * 1024;
+
+namespace {
+
+// Write end of a pipe that fires a pump's cancel_fd.
+struct CancelPipe {
+    int fds[2] = {-1, -1};
+    CancelPipe() { make_pipe(fds); }
+    ~CancelPipe() {
+        close_fd(fds[0]);
+        close_fd(fds[1]);
+    }
+    void fire() {
+        if (fds[1] >= 0) (void)!write(fds[1], "x", 1);
+    }
+};
+
+// Our own copy of a child's stdin pipe, blocking, for a writer thread.
+// The child's copy is closed, so only ours keeps the pipe open.
+int take_stdin(Process& p) {
+    int fd = fcntl(p.stdin_fd(), F_DUPFD_CLOEXEC, 0);
+    p.close_stdin();
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
+// prod (already running) | consumer. input, if any, goes to prod's stdin
+// alongside; consumer_io's stdout sink defaults to collecting into err.
+RelayStatus relay_from(Process& prod, const std::string* input,
+                       const std::vector<std::string>& consumer, ProcIO consumer_io,
+                       int timeout) {
+    RelayStatus st;
+    auto keep_err = [&](const char* d, size_t n) {
+        if (st.err.size() < RELAY_ERR_MAX) st.err.append(d, std::min(n, RELAY_ERR_MAX - st.err.size()));
+    };
+
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::seconds(timeout);
+    bool out_eof = false, err_eof = false;
+    size_t in_off = 0;
+    if (prod.stdin_fd() >= 0 && (!input || input->empty())) prod.close_stdin();
+
+    // Pull the next chunk from the producer, blocking until one arrives.
+    ProcIO& io = consumer_io;
+    if (!io.on_stdout) io.on_stdout = keep_err;
+    io.on_stderr = keep_err;
+    io.stdin_source = [&](char* buf, size_t cap) -> ssize_t {
+        while (!out_eof) {
+            pollfd fds[3];
+            int nfds = 0, i_err = -1, i_in = -1;
+            fds[nfds++] = {prod.stdout_fd(), POLLIN, 0};
+            if (!err_eof) { i_err = nfds; fds[nfds++] = {prod.stderr_fd(), POLLIN, 0}; }
+            if (prod.stdin_fd() >= 0) { i_in = nfds; fds[nfds++] = {prod.stdin_fd(), POLLOUT, 0}; }
+            int wait_ms = 1000;
+            if (timeout > 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - clock::now()).count();
+                if (left <= 0) return -1;
+                wait_ms = static_cast<int>(std::min<long long>(left, wait_ms));
+            }
+            int ready = poll(fds, static_cast<nfds_t>(nfds), wait_ms);
+            if (ready < 0 && errno != EINTR) return -1;
+            if (ready <= 0) continue;
+            if (i_err >= 0 && fds[i_err].revents && !drain_fd(prod.stderr_fd(), keep_err)) {
+                err_eof = true;
+            }
+            if (i_in >= 0 && fds[i_in].revents) {
+                ssize_t n = (fds[i_in].revents & POLLOUT)
+                    ? write(prod.stdin_fd(), input->data() + in_off, input->size() - in_off) : -1;
+                if (n > 0) in_off += static_cast<size_t>(n);
+                if ((n < 0 && errno != EAGAIN && errno != EINTR) || in_off == input->size()) {
+                    prod.close_stdin();
+                }
+            }
+            if (fds[0].revents) {
+                ssize_t n = read(prod.stdout_fd(), buf, cap);
+                if (n > 0) {
+                    st.bytes += static_cast<uint64_t>(n);
+                    return n;
+                }
+                if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+                if (n < 0) return -1;
+                out_eof = true;
+            }
+        }
+        return 0;
+    };
+
+    st.consumer = run_process(consumer, io, timeout);
+
+    // Consumer is done. A healthy producer has already hit EOF; otherwise
+    // it failed or the consumer bailed, and the rest of the stream is moot.
+    if (!st.consumer.error.empty() || st.consumer.exit_code != 0) prod.terminate();
+    ProcIO rest;
+    rest.on_stderr = keep_err;
+    st.producer = prod.pump(rest, 10);
+    return st;
+}
+
+} // namespace
+
+RelayStatus run_relay(const std::vector<std::string>& producer,
+                      const std::vector<std::string>& consumer, int timeout) {
+    Process prod;
+    auto sp = prod.spawn(producer, false);
+    if (sp.is_err()) {
+        RelayStatus st;
+        st.producer.error = sp.error;
+        return st;
+    }
+    return relay_from(prod, nullptr, consumer, {}, timeout);
+}
+
+RelayStatus run_from_writer(const StreamWriter& write_stream,
+                            const std::vector<std::string>& filter,
+                            const std::vector<std::string>& consumer, int timeout) {
+    RelayStatus st;
+    Process first;
+    auto sp = first.spawn(filter.empty() ? consumer : filter, true);
+    if (sp.is_err()) {
+        (filter.empty() ? st.consumer : st.producer).error = sp.error;
+        return st;
+    }
+    int fd = take_stdin(first);
+    Result<uint64_t> written = Result<uint64_t>::Err("no pipe");
+    std::thread writer;
+    if (fd >= 0) {
+        writer = std::thread([&] {
+            written = write_stream(fd);
+            ::close(fd);
+        });
+    }
+
+    if (filter.empty()) {
+        ProcIO io;
+        auto keep_err = [&](const char* d, size_t n) {
+            if (st.err.size() < RELAY_ERR_MAX) st.err.append(d, std::min(n, RELAY_ERR_MAX - st.err.size()));
+        };
+        io.on_stdout = keep_err;
+        io.on_stderr = keep_err;
+        st.consumer = first.pump(io, timeout);
+    } else {
+        st = relay_from(first, nullptr, consumer, {}, timeout);
+    }
+    if (writer.joinable()) writer.join();
+
+    if (written.is_err()) {
+        if (st.producer.error.empty()) st.producer.error = written.error;
+    } else if (filter.empty()) {
+        st.producer.exit_code = 0;  // we were the producer
+        st.bytes = written.value;
+    }
+    return st;
+}
+
+RelayStatus run_to_reader(const std::vector<std::string>& producer, const std::string& input,
+                          const std::vector<std::string>& filter, const StreamReader& read_stream,
+                          int timeout) {
+    CancelPipe cancel;
+    bool stopped = false;
+    ProcIO io;
+    io.cancel_fd = cancel.fds[0];
+    io.on_stdout = [&](const char* d, size_t n) {
+        if (stopped) return;
+        if (!read_stream(d, n)) {
+            stopped = true;
+            cancel.fire();
+        }
+    };
+
+    RelayStatus st;
+    Process prod;
+    auto sp = prod.spawn(producer, true);
+    if (sp.is_err()) {
+        st.producer.error = sp.error;
+        return st;
+    }
+    if (!filter.empty()) {
+        st = relay_from(prod, &input, filter, io, timeout);
+    } else {
+        // The producer is also the consumer: its stdout is the stream
+        size_t in_off = 0;
+        io.stdin_source = [&](char* buf, size_t cap) -> ssize_t {
+            size_t n = std::min(cap, input.size() - in_off);
+            std::memcpy(buf, input.data() + in_off, n);
+            in_off += n;
+            return static_cast<ssize_t>(n);
+        };
+        auto sink = io.on_stdout;
+        io.on_stdout = [&](const char* d, size_t n) {
+            st.bytes += n;
+            sink(d, n);
+        };
+        io.on_stderr = [&](const char* d, size_t n) {
+            if (st.err.size() < RELAY_ERR_MAX) st.err.append(d, std::min(n, RELAY_ERR_MAX - st.err.size()));
+        };
+        st.consumer = prod.pump(io, timeout);
+        st.producer.exit_code = 0;
+    }
+    if (stopped) st.consumer.error = "stream rejected";
+    return st;
+}
+
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "types.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <cstddef>
+using ssize_t = std::ptrdiff_t;
+using pid_t = int;
+#else
+#include <sys/types.h>
+#endif
+
+// ── Process reactor ───────────────────────────────────────
+// Runs a child with piped stdio and drives it from a single poll() loop:
+// stdout and stderr are drained together (no pipe-buffer deadlock), stdin
+// can be fed incrementally, the child's exit wakes the loop immediately
+// (pidfd on Linux), and the deadline covers the whole call.
+
+using OutputSink = std::function<void(const char* data, size_t len)>;
+
+// Fills buf with up to cap bytes for the child's stdin.
+// Returns bytes produced, 0 at end of input, -1 on error.
+using InputSource = std::function<ssize_t(char* buf, size_t cap)>;
+
+struct ProcIO {
+    OutputSink on_stdout;
+    OutputSink on_stderr;
+    InputSource stdin_source;   // unset: child inherits our stdin
+    // If set, the child is terminated as soon as this fd turns readable or
+    // hangs up (e.g. the socket of a client whose command we are relaying).
+    int cancel_fd = -1;
+};
+
+struct ProcStatus {
+    int exit_code = -1;
+    bool timed_out = false;
+    std::string error;
+};
+
+class Process {
+public:
+    Process() = default;
+    ~Process();
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+
+    Result<void> spawn(const std::vector<std::string>& args, bool pipe_stdin = false);
+
+    // Pump I/O until the child exits or the deadline (seconds, 0 = none) passes.
+    ProcStatus pump(const ProcIO& io, int timeout);
+
+    // SIGTERM, short grace period, then SIGKILL. Reaps the child.
+    void terminate();
+
+    pid_t pid() const { return pid_; }
+    int stdin_fd() const { return in_fd_; }
+    int stdout_fd() const { return out_fd_; }
+    int stderr_fd() const { return err_fd_; }
+    bool running() const { return pid_ > 0 && !exited_; }
+
+    // Non-blocking reap; true once the child has exited.
+    bool poll_exit();
+    void close_stdin();
+
+private:
+    pid_t pid_ = -1;
+    int in_fd_ = -1, out_fd_ = -1, err_fd_ = -1;
+    int pid_fd_ = -1;
+    bool exited_ = false;
+    int status_ = 0;
+
+    bool wait_exit_for(int ms);
+    void close_fds();
+    int exit_code() const;
+};
+
+// Splits a byte stream into lines for a line callback. A line longer than
+// max_line is emitted in max_line pieces, so memory stays bounded no matter
+// what the child prints. Call flush() after the stream ends.
+class LineSplitter {
+public:
+    using LineSink = std::function<void(const std::string& line)>;
+
+    explicit LineSplitter(LineSink on_line, size_t max_line = 64 * 1024)
+        : on_line_(std::move(on_line)), max_line_(max_line) {}
+
+    void feed(const char* data, size_t len);
+    void flush();
+    OutputSink sink() { return [this](const char* d, size_t n) { feed(d, n); }; }
+
+private:
+    LineSink on_line_;
+    size_t max_line_;
+    std::string partial_;
+};
+
+// Convenience: spawn + pump.
+ProcStatus run_process(const std::vector<std::string>& args, const ProcIO& io, int timeout);
+
+// producer | consumer, with the stream passing through us so the caller
+// learns exactly how many bytes crossed. Both processes' stderr (and the
+// consumer's stdout) are collected in err. While the consumer is blocked
+// on a slow producer its own output isn't drained; keep it small.
+struct RelayStatus {
+    ProcStatus producer, consumer;
+    uint64_t bytes = 0;
+    std::string err;
+    bool ok() const {
+        return producer.error.empty() && consumer.error.empty() &&
+               producer.exit_code == 0 && consumer.exit_code == 0;
+    }
+};
+RelayStatus run_relay(const std::vector<std::string>& producer,
+                      const std::vector<std::string>& consumer, int timeout);
+
+// A stream we make ourselves into consumer's stdin. The writer runs on a
+// thread of its own with a blocking fd, which it must not close, and
+// returns how many bytes it wrote. With a filter (e.g. a compressor) the
+// stream passes through that first, and bytes counts the filter's output.
+using StreamWriter = std::function<Result<uint64_t>(int fd)>;
+RelayStatus run_from_writer(const StreamWriter& write,
+                            const std::vector<std::string>& filter,
+                            const std::vector<std::string>& consumer, int timeout);
+
+// producer [| filter] into read, in pieces as they arrive; read returns
+// false to stop everything. input goes to the producer's stdin, and
+// bytes counts the producer's output.
+using StreamReader = std::function<bool(const char* data, size_t len)>;
+RelayStatus run_to_reader(const std::vector<std::string>& producer, const std::string& input,
+                          const std::vector<std::string>& filter, const StreamReader& read,
+                          int timeout);
@@ -1,11 +1,19 @@
 #include "session.hpp"
 #include "theme.hpp"
 #include "debug.hpp"
+#include "agent.hpp"
+#include "timing.hpp"
+#include "watch.hpp"
 #include <fmt/format.h>
 #include <iostream>
+#include <atomic>
 #include <chrono>
 #include <ctime>
+#include <deque>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 // ── Container runtime init ────────────────────────────────
@@ -22,6 +30,33 @@ static std::string container_runtime_init() {
         "CEXE=$(command -v apptainer 2>/dev/null || command -v singularity 2>/dev/null || echo singularity)";
 }
 
+// Keep the last few lines of streamed output for error messages.
+static constexpr size_t OUTPUT_TAIL_LINES = 20;
+
+static void push_tail(std::deque<std::string>& tail, const std::string& line) {
+    tail.push_back(line);
+    if (tail.size() > OUTPUT_TAIL_LINES) tail.pop_front();
+}
+
+static std::string join_lines(const std::deque<std::string>& lines) {
+    std::string out;
+    for (const auto& l : lines) {
+        if (!out.empty()) out += "\n";
+        out += l;
+    }
+    return out;
+}
+
+// Status callback safe to call from concurrent start-up steps.
+static StatusCallback serialized(StatusCallback cb) {
+    if (!cb) return cb;
+    auto mu = std::make_shared<std::mutex>();
+    return [cb, mu](const std::string& msg) {
+        std::lock_guard<std::mutex> lock(*mu);
+        cb(msg);
+    };
+}
+
 // ── Construction ──────────────────────────────────────────
 
 Session::Session(const Config& cfg, SSH& ssh, Sync& sync, StateStore& store)
@@ -79,16 +114,40 @@ Result<void> Session::start(StatusCallback cb) {
             "Session already running (job {}). Use 'tccp stop' first.", state_.slurm_id));
     }
 
+    PhaseTimes& phases = phases_;
+    phases.clear();
+
     // 1. Allocate
-    auto alloc_result = allocate(cb);
+    auto alloc_result = phases.time("allocate", [&] { return allocate(cb); });
     if (alloc_result.is_err()) return Result<void>::Err(alloc_result.error);
     std::string job_id = alloc_result.value;
 
-    // 2. Wait for node
-    auto node_result = wait_for_node(job_id, cb);
-    if (node_result.is_err()) {
+    // 2. Wait for node. Meanwhile, what doesn't need one:
+    //   dtach                       (DTN, NFS ~/.tccp/bin)
+    //   scan, then stage            (local hashing; changed files into the
+    //                                NFS object cache for the node to copy,
+    //                                until the node is up)
+    auto wait_cb = serialized(cb);
+    std::atomic<bool> node_up{false};
+    auto dtach_f = std::async(std::launch::async, [&] {
+        return phases.time("dtach", [&] { return ensure_dtach(wait_cb); }, "wait");
+    });
+    auto scan_f = std::async(std::launch::async, [&] {
+        phases.time("scan", [&] { sync_.scan(state_); return true; }, "wait");
+    }).share();
+    auto stage_f = std::async(std::launch::async, [&] {
+        scan_f.wait();
+        phases.time("stage", [&] { sync_.stage(state_, node_up, wait_cb); return true; }, "wait");
+    });
+    auto wait_start = PhaseTimes::clock::now();
+    auto node_result = wait_for_node(job_id, wait_cb);
+    node_up = true;  // staging ends after its current file; push sends the rest
+    auto dtach_result = dtach_f.get();
+    phases.record("wait", PhaseTimes::since(wait_start));
+    if (node_result.is_err() || dtach_result.is_err()) {
+        stage_f.get();
         ssh_.run_login("scancel " + job_id);
-        return Result<void>::Err(node_result.error);
+        return Result<void>::Err(node_result.is_err() ? node_result.error : dtach_result.error);
     }
     std::string node = node_result.value;
 
@@ -100,76 +159,56 @@ Result<void> Session::start(StatusCallback cb) {
     state_.container_sif = sif_path();
     store_.save(state_);
 
-    // 3. Ensure container
-    auto container_result = ensure_container(node, cb);
-    if (container_result.is_err()) {
-        ssh_.run_login("scancel " + job_id);
-        store_.clear();
-        return container_result;
-    }
-
-    // 4. Verify container runtime works
-    {
-        if (cb) cb("Verifying container runtime...");
-        // Create output dirs early so bind mount works
-        ssh_.run(fmt::format("mkdir -p {}", nfs_output()));
-        ssh_.run_compute(node, fmt::format("mkdir -p {}/output", scratch_path()));
-        auto test_cmd = singularity_cmd(scratch_path(), "echo CONTAINER_EXEC_OK");
-        auto test = ssh_.run_compute(node, test_cmd, 30);
-        debug_log("container_verify", fmt::format(
-            "node={} rc={} out=[{}] err=[{}]",
-            node, test.exit_code, trim(test.out), trim(test.err)));
-        if (test.out.find("CONTAINER_EXEC_OK") == std::string::npos) {
-            // Gather diagnostics using same init as the actual exec
-            auto diag = ssh_.run_compute(node, fmt::format(
-                "{}; "
-                "echo \"binary: $CEXE ($($CEXE --version 2>/dev/null))\"; "
-                "echo \"userns: $(cat /proc/sys/user/max_user_namespaces 2>/dev/null || echo unavailable)\"; "
-                "echo \"starter-suid: $(ls $(dirname $CEXE)/../libexec/*/bin/starter-suid 2>/dev/null || echo NONE)\"; "
-                "echo \"loaded: $(module list 2>&1)\"; "
-                "echo \"test_output: {}\"; "
-                "echo \"test_stderr: $({} 2>&1 >/dev/null)\"",
-                container_runtime_init(),
-                trim(test.out),
-                singularity_cmd(scratch_path(), "echo CONTAINER_EXEC_OK")));
-            debug_log("container_verify", fmt::format(
-                "diag rc={} out=[{}] err=[{}]",
-                diag.exit_code, trim(diag.out), trim(diag.err)));
+    // 3-4. Node set-up, run concurrently:
+    //   container → runtime check   (compute /tmp, or NFS when cached)
+    //   project sync                (compute scratch; only step touching state_)
+    auto setup_cb = wait_cb;  // staging may still report
+    auto setup_start = PhaseTimes::clock::now();
+    auto container_f = std::async(std::launch::async, [&] {
+        return phases.time("container", [&] {
+            auto r = ensure_container(node, setup_cb);
+            if (r.is_err()) return r;
+            return verify_container(node, setup_cb);
+        }, "setup");
+    });
+    auto sync_f = std::async(std::launch::async, [&] {
+        scan_f.wait();
+        return phases.time("sync", [&] {
+            if (setup_cb) setup_cb("Syncing project files...");
+            return sync_.push(node, scratch_path(), state_, setup_cb);
+        }, "setup");
+    });
+    Result<void> setup_results[] = {container_f.get(), sync_f.get()};
+    phases.record("setup", PhaseTimes::since(setup_start));
+    stage_f.get();
+    for (const auto& r : setup_results) {
+        if (r.is_err()) {
             ssh_.run_login("scancel " + job_id);
             store_.clear();
-            return Result<void>::Err(fmt::format(
-                "Container runtime cannot create namespaces\n{}\n(stderr: {})",
-                diag.out, trim(diag.err)));
+            return r;
         }
     }
 
-    // 5. Ensure dtach
-    auto dtach_result = ensure_dtach(cb);
-    if (dtach_result.is_err()) {
+    // 7. Env script, init probe and stale socket cleanup via the node agent
+    // (output dirs were created before the container check)
+    auto& agent = ssh_.agent(Target::compute(node));
+    auto env_result = agent.write_file(scratch_path() + "/.tccp-env.sh", build_env_script());
+    if (env_result.is_err()) {
         ssh_.run_login("scancel " + job_id);
         store_.clear();
-        return dtach_result;
+        return env_result;
     }
-
-    // 6. Sync project files
-    if (cb) cb("Syncing project files...");
-    auto sync_result = sync_.push(node, scratch_path(), state_, cb);
-    if (sync_result.is_err()) {
-        ssh_.run_login("scancel " + job_id);
-        store_.clear();
-        return sync_result;
+    std::string init_cmd = cfg_.project.init;
+    if (init_cmd.empty()) {
+        auto probe = agent.stat(scratch_path() + "/tccp_init.sh");
+        if (probe.is_ok() && probe.value.kind == RemoteStat::Kind::File) {
+            init_cmd = "bash tccp_init.sh";
+        }
     }
-
-    // 7. Create output dirs and env script
-    ssh_.run(fmt::format("mkdir -p {}", nfs_output()));
-    ssh_.run_compute(node, fmt::format("mkdir -p {}/output", scratch_path()));
-    auto env_script = build_env_script();
-    ssh_.run_compute(node, fmt::format(
-        "cat > {}/.tccp-env.sh << 'TCCP_ENV_EOF'\n{}\nTCCP_ENV_EOF",
-        scratch_path(), env_script));
+    agent.exec("rm -f " + socket_path());
 
     // 8. Run init
-    auto init_result = run_init(node, scratch_path(), cb);
+    auto init_result = phases.time("init", [&] { return run_init(node, scratch_path(), init_cmd, cb); });
     if (init_result.is_err()) {
         ssh_.run_login("scancel " + job_id);
         store_.clear();
@@ -177,7 +216,7 @@ Result<void> Session::start(StatusCallback cb) {
     }
 
     // 9. Start dtach
-    auto dtach_start = start_dtach(node, scratch_path(), cb);
+    auto dtach_start = phases.time("shell", [&] { return start_dtach(node, scratch_path(), cb); });
     if (dtach_start.is_err()) {
         ssh_.run_login("scancel " + job_id);
         store_.clear();
@@ -193,6 +232,8 @@ Result<void> Session::start(StatusCallback cb) {
 
     // Print status
     if (cb) cb(fmt::format("Session started on {}", node));
+    if (cb) cb("Start-up: " + phases.summary());
+    debug_log("start", phases.summary());
     if (!cfg_.project.ports.empty()) {
         std::string port_list;
         for (int p : cfg_.project.ports) {
@@ -205,6 +246,44 @@ Result<void> Session::start(StatusCallback cb) {
     return Result<void>::Ok();
 }
 
+// ── Container runtime check ───────────────────────────────
+
+Result<void> Session::verify_container(const std::string& node, StatusCallback cb) {
+    if (cb) cb("Verifying container runtime...");
+    // Create output dirs early so bind mount works
+    ssh_.run(fmt::format("mkdir -p {}", nfs_output()));
+    auto verify = ssh_.run_batch(Target::compute(node), {
+        fmt::format("mkdir -p {}/output", scratch_path()),
+        singularity_cmd(scratch_path(), "echo CONTAINER_EXEC_OK"),
+    }, 30);
+    auto& test = verify[1];
+    debug_log("container_verify", fmt::format(
+        "node={} rc={} out=[{}] err=[{}]",
+        node, test.exit_code, trim(test.out), trim(test.err)));
+    if (test.out.find("CONTAINER_EXEC_OK") != std::string::npos) {
+        return Result<void>::Ok();
+    }
+
+    // Gather diagnostics using same init as the actual exec
+    auto diag = ssh_.run_compute(node, fmt::format(
+        "{}; "
+        "echo \"binary: $CEXE ($($CEXE --version 2>/dev/null))\"; "
+        "echo \"userns: $(cat /proc/sys/user/max_user_namespaces 2>/dev/null || echo unavailable)\"; "
+        "echo \"starter-suid: $(ls $(dirname $CEXE)/../libexec/*/bin/starter-suid 2>/dev/null || echo NONE)\"; "
+        "echo \"loaded: $(module list 2>&1)\"; "
+        "echo \"test_output: {}\"; "
+        "echo \"test_stderr: $({} 2>&1 >/dev/null)\"",
+        container_runtime_init(),
+        trim(test.out),
+        singularity_cmd(scratch_path(), "echo CONTAINER_EXEC_OK")));
+    debug_log("container_verify", fmt::format(
+        "diag rc={} out=[{}] err=[{}]",
+        diag.exit_code, trim(diag.out), trim(diag.err)));
+    return Result<void>::Err(fmt::format(
+        "Container runtime cannot create namespaces\n{}\n(stderr: {})",
+        diag.out, trim(diag.err)));
+}
+
 // ── GPU selection ─────────────────────────────────────────
 
 std::string Session::pick_gpu(const std::string& partition, StatusCallback cb) {
@@ -398,10 +477,16 @@ Result<void> Session::ensure_container(const std::string& node, StatusCallback c
 
     if (cb) cb("Checking for container image...");
 
-    // Check in the right place: DTN for NFS cache, compute node for /tmp
-    auto check = cached
-        ? ssh_.run("test -f " + sif + " && echo IMG_OK || echo IMG_MISSING")
-        : ssh_.run_compute(node, "test -f " + sif + " && echo IMG_OK || echo IMG_MISSING");
+    // Check in the right place: DTN for NFS cache, compute node for /tmp.
+    // The target directory is created in the same round trip.
+    std::string container_dir = cached
+        ? "~/.tccp/containers"
+        : fmt::format("/tmp/{}/containers", cfg_.global.user);
+    auto probe = ssh_.run_batch(cached ? Target::dtn() : Target::compute(node), {
+        "test -f " + sif + " && echo IMG_OK || echo IMG_MISSING",
+        "mkdir -p " + container_dir,
+    });
+    auto& check = probe[0];
 
     if (check.out.find("IMG_OK") != std::string::npos) {
         if (cb) cb(cached ? "Container image cached (NFS)" : "Container image cached on node");
@@ -417,84 +502,47 @@ Result<void> Session::ensure_container(const std::string& node, StatusCallback c
     // Pull always on compute node (large /tmp for temp files)
     std::string cache_dir = fmt::format("/tmp/{}/singularity-cache", cfg_.global.user);
     std::string tmp_dir = fmt::format("/tmp/{}/singularity-tmp", cfg_.global.user);
-    std::string pull_log = fmt::format("/tmp/{}/pull.log", cfg_.global.user);
     std::string uri = docker_uri(cfg_.project.container);
 
-    // Ensure target directory exists
-    if (cached) {
-        ssh_.run("mkdir -p ~/.tccp/containers");
-    } else {
-        std::string container_dir = fmt::format("/tmp/{}/containers", cfg_.global.user);
-        ssh_.run_compute(node, "mkdir -p " + container_dir);
-    }
-
-    // Launch pull in background so we can poll progress
+    // Pull in the foreground and follow the runtime's own progress output
     std::string pull_cmd = fmt::format(
-        "{{ {}; mkdir -p {} {}; "
+        "{}; mkdir -p {} {}; "
         "export PATH=~/.tccp/bin:/usr/sbin:/sbin:$PATH; "
         "APPTAINER_CACHEDIR={} APPTAINER_TMPDIR={} "
         "SINGULARITY_CACHEDIR={} SINGULARITY_TMPDIR={} "
-        "$CEXE pull --force {} {}; "
-        "echo TCCP_PULL_RC:$?; }} > {} 2>&1",
+        "$CEXE pull --force {} {} 2>&1",
         container_runtime_init(), cache_dir, tmp_dir,
         cache_dir, tmp_dir,
         cache_dir, tmp_dir,
-        sif, uri, pull_log);
+        sif, uri);
 
-    ssh_.run_compute(node, fmt::format(
-        "rm -f {}; nohup bash -c {} </dev/null > /dev/null 2>&1 &",
-        pull_log, escape_for_ssh(pull_cmd)), 10);
-
-    // Poll log for progress every 5 seconds
     std::string last_phase;
-    for (int i = 0; i < 360; i++) {  // 30 min max
-        sleep_ms(5000);
-
-        auto poll = ssh_.run_compute(node, fmt::format(
-            "SIZE=$(du -sh {} {} 2>/dev/null | awk '{{s=$1}} END{{print s}}'); "
-            "PHASE=$(grep -oE '(Getting image|Copying blob|Copying config|Converting OCI|Creating SIF|FATAL:.*)' {} 2>/dev/null | tail -1); "
-            "echo \"S:$SIZE\"; echo \"P:$PHASE\"; "
-            "grep 'TCCP_PULL_RC:' {} 2>/dev/null || echo RUNNING",
-            cache_dir, tmp_dir, pull_log, pull_log), 15);
-
-        // Parse poll output
-        std::string size, phase;
-        std::istringstream pss(poll.out);
-        std::string pline;
-        while (std::getline(pss, pline)) {
-            if (pline.substr(0, 2) == "S:") size = trim(pline.substr(2));
-            else if (pline.substr(0, 2) == "P:") phase = trim(pline.substr(2));
+    std::deque<std::string> tail;
+    int blobs = 0;
+    LineSplitter lines([&](const std::string& line) {
+        push_tail(tail, line);
+        std::string msg;
+        if (line.find("Creating SIF") != std::string::npos) {
+            msg = "Building SIF image";
+        } else if (line.find("Converting OCI") != std::string::npos) {
+            msg = "Converting to SIF";
+        } else if (line.find("Copying blob") != std::string::npos) {
+            msg = fmt::format("Downloading (layer {})", ++blobs);
         }
-
-        // Build progress message
-        if (cb) {
-            std::string msg;
-            if (phase.find("FATAL") != std::string::npos) {
-                // Will be caught by exit code check below
-            } else if (phase.find("Creating SIF") != std::string::npos) {
-                msg = fmt::format("Building SIF image ({})", size.empty() ? "..." : size);
-            } else if (phase.find("Converting OCI") != std::string::npos) {
-                msg = fmt::format("Converting to SIF ({})", size.empty() ? "..." : size);
-            } else if (!size.empty() && size != "0") {
-                msg = fmt::format("Downloading ({})", size);
-            }
-            if (!msg.empty() && msg != last_phase) {
-                cb(msg);
-                last_phase = msg;
-            }
-        }
-
-        // Check completion
-        if (poll.out.find("TCCP_PULL_RC:0") != std::string::npos) {
-            // Clean up tmp
-            ssh_.run_compute(node, fmt::format("rm -rf {} {}", tmp_dir, pull_log), 10);
-            break;
-        }
-        if (poll.out.find("TCCP_PULL_RC:") != std::string::npos) {
-            auto full_log = ssh_.run_compute(node, fmt::format("cat {}", pull_log), 10);
-            ssh_.run_compute(node, fmt::format("rm -f {}", pull_log), 5);
-            return Result<void>::Err(fmt::format("Container pull failed: {}", full_log.out));
+        if (cb && !msg.empty() && msg != last_phase) {
+            cb(msg);
+            last_phase = msg;
         }
+    });
+    ProcIO io;
+    io.on_stdout = lines.sink();
+    io.on_stderr = lines.sink();
+    auto pull = ssh_.run_streaming(Target::compute(node), pull_cmd, io, 1800);
+    lines.flush();
+    ssh_.run_compute(node, fmt::format("rm -rf {}", tmp_dir), 10);
+    if (!pull.ok()) {
+        return Result<void>::Err(fmt::format("Container pull failed: {}",
+                                             pull.err.empty() ? join_lines(tail) : pull.err));
     }
 
     // Verify from correct location
@@ -518,13 +566,14 @@ Result<void> Session::ensure_container(const std::string& node, StatusCallback c
 
 Result<void> Session::ensure_mksquashfs(const std::string& node) {
     // Check if mksquashfs is already cached on NFS (persists across nodes)
-    auto cached = ssh_.run("test -x ~/.tccp/bin/mksquashfs && echo OK");
-    if (cached.out.find("OK") != std::string::npos) {
+    auto cached = ssh_.run_batch(Target::dtn(), {
+        "test -x ~/.tccp/bin/mksquashfs && echo OK",
+        "mkdir -p ~/.tccp/bin",
+    });
+    if (cached[0].out.find("OK") != std::string::npos) {
         return Result<void>::Ok();
     }
 
-    ssh_.run("mkdir -p ~/.tccp/bin");
-
     // Search compute node: native paths + modules + apptainer libexec
     auto compute = ssh_.run_compute(node,
         "type module &>/dev/null || . /etc/profile 2>/dev/null || true; "
@@ -556,17 +605,20 @@ Result<void> Session::ensure_mksquashfs(const std::string& node) {
 
 Result<void> Session::ensure_dtach(StatusCallback cb) {
     std::string bin = dtach_bin();
-    auto check = ssh_.run("test -x " + bin + " && echo DTACH_OK || echo DTACH_MISSING");
-    if (check.out.find("DTACH_OK") != std::string::npos) {
+    auto probe = ssh_.run_batch(Target::dtn(), {
+        "test -x " + bin + " && echo DTACH_OK || echo DTACH_MISSING",
+        "which dtach 2>/dev/null",
+    });
+    if (probe[0].out.find("DTACH_OK") != std::string::npos) {
         return Result<void>::Ok();
     }
 
     // Check system dtach
-    auto sys = ssh_.run("which dtach 2>/dev/null");
+    auto& sys = probe[1];
     if (sys.ok() && !sys.out.empty()) {
-        ssh_.run("mkdir -p ~/.tccp/bin");
-        ssh_.run(fmt::format("cp {} {} && chmod +x {}", trim(sys.out), bin, bin));
-        auto v = ssh_.run("test -x " + bin + " && echo OK");
+        auto v = ssh_.run(fmt::format(
+            "mkdir -p ~/.tccp/bin && cp {} {} && chmod +x {} && test -x {} && echo OK",
+            trim(sys.out), bin, bin, bin));
         if (v.out.find("OK") != std::string::npos) {
             if (cb) cb("dtach: copied from system");
             return Result<void>::Ok();
@@ -617,6 +669,11 @@ Result<void> Session::ensure_dtach(StatusCallback cb) {
 std::string Session::singularity_cmd(const std::string& scratch, const std::string& inner) const {
     std::string nv = "--nv ";
     std::string binds = fmt::format("-B {}:{}", nfs_output(), scratch + "/output");
+    // rodata images, once Sync has built them (verify_container runs alongside the first push)
+    for (const auto& dir : rodata_dirs(cfg_.project)) {
+        std::string img = rodata_image(cfg_.project_name, dir);
+        binds += fmt::format(" $(test -f {0} && echo -B {0}:{1}/{2}:image-src=/)", img, scratch, dir);
+    }
 
     return fmt::format(
         "{}; cd {}; $CEXE exec --env \"PS1=tccp> \" --env TERM=xterm-256color {}{} {} {}",
@@ -642,17 +699,7 @@ std::string Session::build_env_script() const {
 // ── Init ──────────────────────────────────────────────────
 
 Result<void> Session::run_init(const std::string& node, const std::string& scratch,
-                               StatusCallback cb) {
-    std::string init_cmd = cfg_.project.init;
-
-    // Fallback to tccp_init.sh if it exists
-    if (init_cmd.empty()) {
-        auto check = ssh_.run_compute(node, fmt::format("test -f {}/tccp_init.sh && echo YES", scratch));
-        if (check.out.find("YES") != std::string::npos) {
-            init_cmd = "bash tccp_init.sh";
-        }
-    }
-
+                               const std::string& init_cmd, StatusCallback cb) {
     if (init_cmd.empty()) {
         if (cb) cb("No init command, skipping");
         return Result<void>::Ok();
@@ -660,9 +707,21 @@ Result<void> Session::run_init(const std::string& node, const std::string& scrat
 
     if (cb) cb(fmt::format("Running init: {}", init_cmd));
     auto cmd = singularity_cmd(scratch, fmt::format("bash -c 'source .tccp-env.sh && {}'", init_cmd));
-    auto result = ssh_.run_compute(node, cmd, 600);
+
+    // Show init output as it runs; keep only the tail for the error message
+    std::deque<std::string> tail;
+    LineSplitter lines([&](const std::string& line) {
+        push_tail(tail, line);
+        if (cb) cb("  " + line);
+    });
+    ProcIO io;
+    io.on_stdout = lines.sink();
+    io.on_stderr = lines.sink();
+    auto result = ssh_.run_streaming(Target::compute(node), cmd, io, 600);
+    lines.flush();
     if (!result.ok()) {
-        return Result<void>::Err(fmt::format("Init failed (exit {}): {}", result.exit_code, result.out));
+        return Result<void>::Err(fmt::format("Init failed (exit {}): {}", result.exit_code,
+                                             result.err.empty() ? join_lines(tail) : result.err));
     }
     if (cb) cb("Init complete");
     return Result<void>::Ok();
@@ -674,26 +733,22 @@ Result<void> Session::start_dtach(const std::string& node, const std::string& sc
                                   StatusCallback cb) {
     if (cb) cb("Starting shell session...");
 
+    // Stale sockets from previous sessions were removed by the caller.
     std::string sock = socket_path();
 
-    // Remove stale socket from previous failed/interrupted sessions
-    ssh_.run_compute(node, "rm -f " + sock);
-
     std::string inner = fmt::format("bash --rcfile {scratch}/.tccp-env.sh",
                                     fmt::arg("scratch", scratch));
     std::string cmd = singularity_cmd(scratch, inner);
 
-    auto result = ssh_.run_compute(node, fmt::format("{} -n {} bash -c {}",
-                                                     dtach_bin(), sock, escape_for_ssh(cmd)));
+    // Launch and verify the socket in the same round trip
+    auto result = ssh_.run_compute(node, fmt::format(
+        "{} -n {} bash -c {} || exit $?; sleep 0.5; test -S {} && echo SOCK_OK; true",
+        dtach_bin(), sock, escape_for_ssh(cmd), sock));
     if (!result.ok()) {
         std::string detail = result.err.empty() ? result.out : result.err;
         return Result<void>::Err(fmt::format("Failed to start dtach (exit {}): {}", result.exit_code, detail));
     }
-
-    // Verify socket exists
-    sleep_ms(500);
-    auto check = ssh_.run_compute(node, "test -S " + sock + " && echo OK");
-    if (check.out.find("OK") == std::string::npos) {
+    if (result.out.find("SOCK_OK") == std::string::npos) {
         return Result<void>::Err("dtach socket not found after launch");
     }
 
@@ -712,8 +767,11 @@ int Session::shell() {
     std::string node = state_.compute_node;
     std::string sock = socket_path();
 
-    // Verify job is still running
-    auto job_check = ssh_.run_login(fmt::format("squeue -j {} -h -o '%T'", state_.slurm_id));
+    // Verify job is still running (and, concurrently, that the socket exists)
+    auto job_f = ssh_.run_login_async(fmt::format("squeue -j {} -h -o '%T'", state_.slurm_id));
+    auto& agent = ssh_.agent(Target::compute(node));
+    auto sock_check = agent.socket_exists(sock);
+    auto job_check = job_f.get();
     std::string job_state = trim(job_check.out);
     if (!job_check.ok() || job_state.empty() ||
         (job_state.find("RUNNING") == std::string::npos && job_state.find("PENDING") == std::string::npos)) {
@@ -724,9 +782,7 @@ int Session::shell() {
         return 1;
     }
 
-    // Verify socket exists
-    auto sock_check = ssh_.run_compute(node, "test -S " + sock + " && echo OK");
-    if (sock_check.out.find("OK") == std::string::npos) {
+    if (!sock_check.is_ok() || !sock_check.value) {
         std::cerr << theme::error("Shell session not found (dtach socket missing).");
         std::cerr << theme::error("Run 'tccp stop' then 'tccp start' to create a new session.");
         return 1;
@@ -743,8 +799,8 @@ int Session::shell() {
         int rc = ssh_.interactive(node, inner_cmd, cfg_.project.ports);
 
         // Check if dtach socket still exists
-        auto check = ssh_.run_compute(node, "test -S " + sock + " && echo ALIVE");
-        if (check.out.find("ALIVE") == std::string::npos) {
+        auto alive = agent.socket_exists(sock);
+        if (alive.is_err() || !alive.value) {
             // Shell exited (Ctrl+D / exit)
             auto job = ssh_.run_login(fmt::format("squeue -j {} -h -o '%T'", state_.slurm_id));
             if (!job.ok() || trim(job.out).empty()) {
@@ -770,6 +826,15 @@ int Session::shell() {
 // ── Exec ──────────────────────────────────────────────────
 
 Result<int> Session::exec(const std::string& cmd) {
+    // Stream straight through; writes block while the terminal/pipe is
+    // full, which in turn throttles the remote command.
+    ProcIO io;
+    io.on_stdout = [](const char* d, size_t n) { std::cout.write(d, n).flush(); };
+    io.on_stderr = [](const char* d, size_t n) { std::cerr.write(d, n).flush(); };
+    return exec(cmd, std::move(io));
+}
+
+Result<int> Session::exec(const std::string& cmd, ProcIO io) {
     if (!active()) {
         return Result<int>::Err("No active session. Run 'tccp start' first.");
     }
@@ -779,10 +844,10 @@ Result<int> Session::exec(const std::string& cmd) {
                     fmt::arg("scratch", state_.scratch),
                     fmt::arg("cmd", cmd)));
 
-    auto result = ssh_.run_compute(state_.compute_node, full, 0);
-    if (!result.out.empty()) std::cout << result.out << "\n";
-    if (!result.err.empty()) std::cerr << result.err << "\n";
-
+    auto result = ssh_.run_streaming(Target::compute(state_.compute_node), full, io, 0);
+    if (result.exit_code < 0 && !result.err.empty()) {
+        return Result<int>::Err(result.err);
+    }
     return Result<int>::Ok(result.exit_code);
 }
 
@@ -797,6 +862,54 @@ Result<void> Session::sync_files(StatusCallback cb) {
     return result;
 }
 
+Result<void> Session::watch(StatusCallback cb, int stop_fd) {
+    auto initial = sync_files(cb);
+    if (initial.is_err()) return initial;
+
+    GitignoreParser parser(cfg_.project_dir, cfg_.project.rodata);
+    Watcher watcher(cfg_.project_dir, parser);
+    if (!watcher.start()) {
+        if (cb) cb(fmt::format("File events unavailable; rescanning every {}s",
+                               Watcher::POLL_MS / 1000));
+    }
+    if (cb) cb("Watching for changes (Ctrl-C to stop)");
+
+    std::map<std::string, ManifestEntry> live;
+    for (auto& e : state_.manifest) live[e.path] = std::move(e);
+    auto save = [&] {
+        state_.manifest.clear();
+        for (const auto& [path, e] : live) state_.manifest.push_back(e);
+        store_.save(state_);
+    };
+
+    bool polling = watcher.polling();
+    while (true) {
+        WatchBatch batch = watcher.next(200, 1000, stop_fd);
+        if (batch.stopped) break;
+        if (!polling && watcher.polling()) {
+            polling = true;
+            if (cb) cb(fmt::format("Out of file watches; rescanning every {}s",
+                                   Watcher::POLL_MS / 1000));
+        }
+        if (batch.rescan) {
+            for (const auto& f : parser.collect_files()) {
+                batch.paths.insert(parser.get_relative_path(f).generic_string());
+            }
+            for (const auto& [path, e] : live) batch.paths.insert(path);
+        }
+        if (batch.paths.empty()) continue;
+
+        auto result = sync_.push_paths(state_.compute_node, state_.scratch, live, batch.paths, cb);
+        if (result.is_err()) {
+            std::cerr << theme::error(result.error);
+            continue;  // live is unchanged, so the next batch retries
+        }
+        save();  // a killed watch keeps what it synced
+    }
+    save();
+    return Result<void>::Ok();
+}
+
 // ── Status ────────────────────────────────────────────────
 
 void Session::status() {
@@ -845,13 +958,17 @@ Result<void> Session::stop(StatusCallback cb) {
     if (job_alive) {
         // Pull output before canceling
         if (cb) cb("Pulling output...");
-        sync_.pull_output(cb);
+        auto pulled = sync_.pull_output(cb);
+        if (pulled.is_err() && cb) {
+            cb(fmt::format("Output not pulled: {}", pulled.error));
+        }
 
         if (cb) cb(fmt::format("Canceling job {}...", state_.slurm_id));
         ssh_.run_login("scancel " + state_.slurm_id);
     } else {
         if (cb) cb("Job already ended.");
     }
+    ssh_.close_inner(state_.compute_node);
 
     // Always clear state
     store_.clear();
@@ -5,6 +5,7 @@
 #include "sync.hpp"
 #include "state.hpp"
 #include "config.hpp"
+#include "timing.hpp"
 
 class Session {
 public:
@@ -14,10 +15,17 @@ public:
     int shell();
     int login_shell() { return ssh_.login_shell(); }
     Result<int> exec(const std::string& cmd);
+    // Same, with output handed to io's sinks instead of our stdout/stderr.
+    Result<int> exec(const std::string& cmd, ProcIO io);
     Result<void> sync_files(StatusCallback cb);
+    // Sync, then keep pushing changes as files are saved until stop_fd
+    // becomes readable.
+    Result<void> watch(StatusCallback cb, int stop_fd);
     void status();
     Result<void> stop(StatusCallback cb);
     bool active() const;
+    // Per-phase wall-clock times of the last start().
+    const PhaseTimes& start_timing() const { return phases_; }
 
 private:
     const Config& cfg_;
@@ -25,14 +33,17 @@ private:
     Sync& sync_;
     StateStore& store_;
     SessionState state_;
+    PhaseTimes phases_;
 
     Result<std::string> allocate(StatusCallback cb);
     std::string pick_gpu(const std::string& partition, StatusCallback cb);
     Result<std::string> wait_for_node(const std::string& id, StatusCallback cb);
     Result<void> ensure_container(const std::string& node, StatusCallback cb);
+    Result<void> verify_container(const std::string& node, StatusCallback cb);
     Result<void> ensure_mksquashfs(const std::string& node);
     Result<void> ensure_dtach(StatusCallback cb);
-    Result<void> run_init(const std::string& node, const std::string& scratch, StatusCallback cb);
+    Result<void> run_init(const std::string& node, const std::string& scratch,
+                          const std::string& init_cmd, StatusCallback cb);
     Result<void> start_dtach(const std::string& node, const std::string& scratch, StatusCallback cb);
 
     std::string singularity_cmd(const std::string& scratch, const std::string& inner) const;
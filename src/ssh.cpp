@@ -1,9 +1,19 @@
 #include "ssh.hpp"
 #include "debug.hpp"
+#include "proc.hpp"
+#include "agent.hpp"
+#include "compress.hpp"
+#include "archive.hpp"
 #include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <fstream>
 #include <chrono>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 #ifndef _WIN32
 #include <sys/wait.h>
 #include <signal.h>
@@ -14,6 +24,26 @@
 static const std::string SSH_OPTS =
     "-o StrictHostKeyChecking=no -o BatchMode=yes -o LogLevel=ERROR";
 
+// Inner hop multiplexing (DTN → login/compute). The first call to a node
+// becomes a ControlMaster on the DTN; later calls just open a channel on it.
+// The socket lives in ~/.tccp/cm, private to us (a shared /tmp would let
+// other users of the DTN squat on or reach it). Each inner hop makes sure
+// of that first: a shell builtin test once the directory exists, so it
+// costs no round trip. %C hashes the DTN's hostname in, so DTNs sharing the NFS home
+// don't collide. A stale socket makes ssh fall back to a direct connection.
+static const std::string INNER_CTL_DIR = "~/.tccp/cm";
+static const std::string INNER_CTL_PATH = INNER_CTL_DIR + "/%C";
+static const std::string INNER_MUX_OPTS =
+    "-o ControlMaster=auto -o ControlPath=" + INNER_CTL_PATH + " -o ControlPersist=10m";
+
+static const std::string INNER_CTL_READY = fmt::format(
+    "{{ [ -O {0} ] || {{ mkdir -p {0} && chmod 700 {0} && [ -O {0} ]; }} || "
+    "{{ echo '{0} is not a directory of ours' >&2; exit 1; }}; }} && ", INNER_CTL_DIR);
+
+static std::string inner_opts() {
+    return SSH_OPTS + " " + INNER_MUX_OPTS;
+}
+
 // ── escape_for_ssh ────────────────────────────────────────
 
 std::string escape_for_ssh(const std::string& cmd) {
@@ -36,18 +66,40 @@ std::string escape_for_ssh(const std::string& cmd) {
 
 SSH::SSH(std::string host, std::string login, std::string user, std::string password)
     : host_(std::move(host)), login_(std::move(login)), user_(std::move(user)), password_(std::move(password)) {}
+SSH::~SSH() = default;
 
 std::vector<std::string> SSH::base_args(bool) const { return {}; }
 Result<void> SSH::connect() { return Result<void>::Err("SSH not supported on Windows"); }
 void SSH::disconnect() {}
+void SSH::close_inner(const std::string&) {}
 SSHResult SSH::run(const std::string&, int) { return {-1, "", "not supported on Windows"}; }
 SSHResult SSH::run_login(const std::string&, int) { return {-1, "", "not supported on Windows"}; }
 SSHResult SSH::run_compute(const std::string&, const std::string&, int) { return {-1, "", "not supported on Windows"}; }
-Result<void> SSH::tar_push(const std::string&, const fs::path&, const std::vector<std::string>&, const std::string&) { return Result<void>::Err("not supported on Windows"); }
-Result<void> SSH::tar_pull(const std::string&, const fs::path&) { return Result<void>::Err("not supported on Windows"); }
+SSHResult SSH::run_on(const Target&, const std::string&, int) { return {-1, "", "not supported on Windows"}; }
+std::vector<SSHResult> SSH::run_batch(const Target&, const std::vector<std::string>& cmds, int) {
+    return std::vector<SSHResult>(cmds.size(), SSHResult{-1, "", "not supported on Windows"});
+}
+std::vector<std::string> SSH::remote_args(const Target&, const std::string&, bool) const { return {}; }
+SSHResult SSH::run_with_input(const Target&, const std::string&, const std::string&, int) { return {-1, "", "not supported on Windows"}; }
+SSHResult SSH::run_streaming(const Target&, const std::string&, ProcIO, int) { return {-1, "", "not supported on Windows"}; }
+Result<void> SSH::open_channel(const Target&, const std::string&, Process&) { return Result<void>::Err("not supported on Windows"); }
+Agent& SSH::agent(const Target& target) {
+    std::lock_guard<std::mutex> lock(agents_mu_);
+    auto& a = agents_[target.node];
+    if (!a) a = std::make_unique<Agent>(*this, target);
+    return *a;
+}
+Result<void> SSH::tar_push(const std::string&, const fs::path&, const std::vector<std::string>&, const std::string&, const std::vector<std::string>&, bool, PushProgress*) { return Result<void>::Err("not supported on Windows"); }
+Result<void> SSH::tar_to_command(const Target&, const fs::path&, const std::vector<std::string>&, const std::string&, const std::vector<std::string>&, const std::atomic<bool>*) { return Result<void>::Err("not supported on Windows"); }
+Result<void> SSH::tar_pull(const std::string&, const fs::path&, const std::vector<std::string>&) { return Result<void>::Err("not supported on Windows"); }
+Result<int> SSH::transfer_level() { return Result<int>::Ok(0); }
+bool SSH::zstd_available() { return false; }
+Result<void> SSH::push_stream(const std::string&, const fs::path&, const std::vector<std::string>&, const std::vector<std::string>&, const std::string&, int, bool, uint64_t*) { return Result<void>::Err("not supported on Windows"); }
+Result<void> SSH::push_parallel(const std::string&, const fs::path&, const std::vector<std::string>&, const std::vector<std::string>&, const std::string&, int, int, PushProgress*) { return Result<void>::Err("not supported on Windows"); }
+Result<uint64_t> SSH::relay_to(const Target&, const StreamWriter&, const std::string&, int, uint64_t) { return Result<uint64_t>::Err("not supported on Windows"); }
 int SSH::interactive(const std::string&, const std::string&, const std::vector<int>&) { return -1; }
 int SSH::login_shell() { return -1; }
-SSHResult SSH::exec_capture(const std::vector<std::string>&, int) { return {-1, "", "not supported on Windows"}; }
+SSHResult SSH::exec_capture(const std::vector<std::string>&, int, const std::string*) { return {-1, "", "not supported on Windows"}; }
 int SSH::exec_passthrough(const std::vector<std::string>&) { return -1; }
 
 #else
@@ -58,6 +110,11 @@ SSH::SSH(std::string host, std::string login, std::string user, std::string pass
     ctl_path_ = home_dir() / ".tccp" / fmt::format("ssh-ctl-{}@{}", user_, host_);
 }
 
+SSH::~SSH() {
+    // Agents talk through this object's ControlMaster; shut them down first.
+    agents_.clear();
+}
+
 std::vector<std::string> SSH::base_args(bool tty) const {
     std::vector<std::string> args = {
         "ssh",
@@ -150,88 +207,661 @@ void SSH::disconnect() {
     }, 5);
 }
 
+// ── Close inner-hop master (DTN → node) ───────────────────
+
+void SSH::close_inner(const std::string& node) {
+    run(fmt::format("ssh -o ControlPath={} -O exit {} 2>/dev/null; true",
+                    INNER_CTL_PATH, node), 10);
+}
+
+// ── Remote argv ───────────────────────────────────────────
+
+std::vector<std::string> SSH::remote_args(const Target& target, const std::string& cmd,
+                                          bool with_stdin) const {
+    auto args = base_args(false);
+    if (target.hop == Target::Hop::DTN) {
+        args.push_back(cmd);
+        return args;
+    }
+    const std::string& host = target.hop == Target::Hop::Login ? login_ : target.node;
+    args.push_back(fmt::format("{}ssh {} {} {}{}", INNER_CTL_READY, inner_opts(), host, escape_for_ssh(cmd),
+                               with_stdin ? "" : " </dev/null"));
+    return args;
+}
+
 // ── Run command on DTN ────────────────────────────────────
 
 SSHResult SSH::run(const std::string& cmd, int timeout) {
-    auto args = base_args(false);
-    args.push_back(cmd);
-    return exec_capture(args, timeout);
+    return run_on(Target::dtn(), cmd, timeout);
 }
 
 // ── Run command on login node (via DTN hop) ───────────────
 
 SSHResult SSH::run_login(const std::string& cmd, int timeout) {
-    std::string inner = fmt::format("ssh {} {} {} </dev/null",
-                                    SSH_OPTS, login_, escape_for_ssh(cmd));
-    auto args = base_args(false);
-    args.push_back(inner);
-    return exec_capture(args, timeout);
+    return run_on(Target::login(), cmd, timeout);
 }
 
 // ── Run command on compute node (via DTN hop) ─────────────
 
 SSHResult SSH::run_compute(const std::string& node, const std::string& cmd, int timeout) {
-    std::string inner = fmt::format("ssh {} {} {} </dev/null",
-                                    SSH_OPTS, node, escape_for_ssh(cmd));
-    auto args = base_args(false);
-    args.push_back(inner);
-    return exec_capture(args, timeout);
+    return run_on(Target::compute(node), cmd, timeout);
+}
+
+SSHResult SSH::run_on(const Target& target, const std::string& cmd, int timeout) {
+    return exec_capture(remote_args(target, cmd), timeout);
+}
+
+SSHResult SSH::run_with_input(const Target& target, const std::string& cmd,
+                              const std::string& input, int timeout) {
+    return exec_capture(remote_args(target, cmd, true), timeout, &input);
+}
+
+SSHResult SSH::run_streaming(const Target& target, const std::string& cmd,
+                             ProcIO io, int timeout) {
+    auto args = remote_args(target, cmd, static_cast<bool>(io.stdin_source));
+    if (!io.stdin_source) {
+        io.stdin_source = [](char*, size_t) -> ssize_t { return 0; };
+    }
+    auto t_start = std::chrono::steady_clock::now();
+    debug_log("ssh", fmt::format("→ stream (timeout={}s) {}", timeout, debug_truncate(args.back(), 8000)));
+
+    size_t out_bytes = 0, err_bytes = 0;
+    ProcIO counted = io;
+    counted.on_stdout = [&](const char* d, size_t n) {
+        out_bytes += n;
+        if (io.on_stdout) io.on_stdout(d, n);
+    };
+    counted.on_stderr = [&](const char* d, size_t n) {
+        err_bytes += n;
+        if (io.on_stderr) io.on_stderr(d, n);
+    };
+    auto st = run_process(args, counted, timeout);
+
+    SSHResult result{};
+    result.exit_code = st.exit_code;
+    if (!st.error.empty()) {
+        result.exit_code = -1;
+        result.err = st.error;
+    }
+    if (debug_enabled()) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t_start).count();
+        debug_log("ssh", fmt::format("← stream rc={} ({}ms) stdout={} bytes stderr={} bytes{}",
+            result.exit_code, ms, out_bytes, err_bytes,
+            st.error.empty() ? "" : " error=" + st.error));
+    }
+    return result;
+}
+
+// ── Long-lived channels and agents ────────────────────────
+
+Result<void> SSH::open_channel(const Target& target, const std::string& cmd, Process& proc) {
+    auto args = remote_args(target, cmd, true);
+    debug_log("ssh", fmt::format("⇄ channel {}", debug_truncate(args.back(), 500)));
+    return proc.spawn(args, true);
+}
+
+Agent& SSH::agent(const Target& target) {
+    std::string key = fmt::format("{}:{}", static_cast<int>(target.hop), target.node);
+    Agent* a;
+    {
+        std::lock_guard<std::mutex> lock(agents_mu_);
+        auto& slot = agents_[key];
+        if (slot) return *slot;
+        slot = std::make_unique<Agent>(*this, target);
+        a = slot.get();
+    }
+    a->start();
+    return *a;
+}
+
+// ── Batched commands ──────────────────────────────────────
+// Framing: for each command the remote script prints a header line
+//   <nonce> <index> <exit code> <stdout bytes> <stderr bytes>
+// followed by exactly that many bytes of stdout and stderr. The nonce is
+// random per batch, so command output can't forge a header, and the byte
+// counts make the payload opaque (no escaping of command output needed).
+
+static std::string batch_nonce() {
+    std::random_device rd;
+    return fmt::format("TCCP-BATCH-{:08x}{:08x}", rd(), rd());
+}
+
+std::vector<SSHResult> SSH::run_batch(const Target& target,
+                                      const std::vector<std::string>& cmds, int timeout) {
+    std::vector<SSHResult> results(cmds.size(), SSHResult{-1, "", "no result"});
+    if (cmds.empty()) return results;
+
+    std::string nonce = batch_nonce();
+    std::string script =
+        "t=$(mktemp -d 2>/dev/null) || { t=/tmp/tccp-batch-$$; mkdir -p \"$t\"; } || exit 97\n";
+    for (size_t i = 0; i < cmds.size(); i++) {
+        script += fmt::format(
+            "(\n{}\n) >\"$t/o\" 2>\"$t/e\" </dev/null; r=$?\n"
+            "printf '%s %d %d %d %d\\n' {} {} \"$r\" \"$(wc -c <\"$t/o\")\" \"$(wc -c <\"$t/e\")\"\n"
+            "cat \"$t/o\" \"$t/e\"\n",
+            cmds[i], nonce, i);
+    }
+    script += fmt::format("rm -rf \"$t\"\necho {} END\n", nonce);
+
+    auto raw = exec_capture(remote_args(target, "sh -s", true), timeout, &script);
+
+    // Parse frames
+    const std::string& out = raw.out;
+    size_t pos = 0;
+    size_t parsed = 0;
+    while (true) {
+        size_t h = out.find(nonce + " ", pos);
+        if (h == std::string::npos) break;
+        size_t eol = out.find('\n', h);
+        if (eol == std::string::npos) break;
+        std::istringstream hdr(out.substr(h + nonce.size() + 1, eol - h - nonce.size() - 1));
+        size_t idx = 0, out_len = 0, err_len = 0;
+        int rc = -1;
+        if (!(hdr >> idx >> rc >> out_len >> err_len)) break;  // END marker
+        size_t body = eol + 1;
+        if (idx >= results.size() || body + out_len + err_len > out.size()) break;
+
+        auto& r = results[idx];
+        r.exit_code = rc;
+        r.out = out.substr(body, out_len);
+        r.err = out.substr(body + out_len, err_len);
+        while (!r.out.empty() && (r.out.back() == '\n' || r.out.back() == '\r'))
+            r.out.pop_back();
+        pos = body + out_len + err_len;
+        parsed++;
+    }
+
+    if (parsed < cmds.size()) {
+        std::string why = raw.err.empty() ? "batch transport failed" : raw.err;
+        for (auto& r : results) {
+            if (r.err == "no result") r.err = why;
+        }
+    }
+    return results;
 }
 
 // ── Tar push (local → compute node) ──────────────────────
+// tar cf - | zstd  →  [relay]  →  ssh DTN 'zstd -d | ssh node "tar xf -"'
+// The stream passes through us so the wire bytes can be measured; the
+// DTN decompresses, since only the local ↔ DTN link is slow.
+
+bool SSH::zstd_available() {
+    std::lock_guard<std::mutex> lock(zstd_mu_);
+    if (zstd_ok_ < 0) {
+        auto local = run_process({"sh", "-c", "command -v zstd"}, ProcIO{}, 5);
+        auto remote = run("command -v zstd >/dev/null", 15);
+        zstd_ok_ = local.exit_code == 0 && remote.exit_code == 0 ? 1 : 0;
+        debug_log("ssh", fmt::format("zstd local={} remote={}", local.exit_code == 0, remote.exit_code == 0));
+    }
+    return zstd_ok_ == 1;
+}
+
+Result<int> SSH::transfer_level() {
+    auto level = compression_level(compression_, load_link_stats(host_));
+    if (level.is_err() || level.value == 0) return level;
+    if (!zstd_available()) return Result<int>::Ok(0);
+    return level;
+}
+
+// The stream: a decimal byte count and newline, that many bytes
+// of NUL-separated paths to delete, then the tar archive. The node reads
+// the header with the shell's byte-wise `read` and the list with an exact
+// dd, so tar sees the stream from its first byte. Deletions go first: a
+// path can change between file and directory.
+//
+// Staged, the archive is extracted into .tccp-stage and nothing in the
+// tree changes until it arrived whole (ending in STAGE_END); then
+// deletions are applied and every file is renamed into place. A broken
+// stream leaves the tree as it was. (The directory itself can't be
+// swapped: the container bind-mounts it by inode.)
+
+static const std::string STAGE_DIR = ".tccp-stage";
+// Last member of a staged archive. GNU tar accepts an archive cut off at
+// a header boundary, so this is how the node knows all of it arrived.
+static const std::string STAGE_END = ".tccp-end";
+
+// Moves the staged files over the tree with rename(2), so each file
+// changes in one step; deletions first.
+static const std::string STAGE_COMMIT_PY =
+    "import os\n"
+    "S='" + STAGE_DIR + "'\n"
+    "for p in open(S+'.del','rb').read().split(b'\\0'):\n"
+    " if p:\n"
+    "  try: os.remove(p)\n"
+    "  except OSError: pass\n"
+    "for r,ds,fs in os.walk(S):\n"
+    " t=os.path.relpath(r,S)\n"
+    " for d in ds:\n"
+    "  q=os.path.normpath(os.path.join(t,d))\n"
+    "  if not os.path.isdir(q):\n"
+    "   if os.path.lexists(q): os.remove(q)\n"
+    "   os.mkdir(q)\n"
+    " for f in fs:\n"
+    "  q=os.path.normpath(os.path.join(t,f))\n"
+    "  if os.path.isdir(q) and not os.path.islink(q): os.rmdir(q)\n"
+    "  os.replace(os.path.join(r,f),q)\n";
+
+static std::string apply_stream_cmd(const std::string& remote_dir, bool staged) {
+    std::string read_deletes = "IFS= read -r n && { [ \"$n\" = 0 ] || "
+                               "dd bs=\"$n\" count=1 iflag=fullblock status=none; }";
+    if (!staged) {
+        return fmt::format("mkdir -p {0} && cd {0} && {1} | xargs -0 -r rm -f -- && tar xf -",
+                           remote_dir, read_deletes);
+    }
+    // Without python3, fall back to a copy: still only after the whole stream arrived
+    return fmt::format(
+        "mkdir -p {0} && cd {0} && rm -rf {1} && mkdir {1} && {2} > {1}.del && "
+        "tar xf - -C {1} && {{ rm {1}/{4} 2>/dev/null || {{ echo 'stream cut short' >&2; false; }}; }} && {{ python3 -c {3} 2>/dev/null || "
+        "{{ xargs -0 -r rm -f -- < {1}.del && cp -a {1}/. . ; }}; }}; "
+        "rc=$?; rm -rf {1} {1}.del; exit $rc",
+        remote_dir, STAGE_DIR, read_deletes, escape_for_ssh(STAGE_COMMIT_PY), STAGE_END);
+}
+
+// At least 10 minutes, and longer for streams that need it below 1 MB/s.
+static int relay_timeout(uint64_t raw_bytes) {
+    return static_cast<int>(std::max<uint64_t>(600, raw_bytes >> 20));
+}
+
+Result<uint64_t> SSH::relay_to(const Target& target, const StreamWriter& produce,
+                               const std::string& cmd, int level, uint64_t raw_bytes) {
+    std::string dtn_cmd = target.hop == Target::Hop::Compute
+        ? fmt::format("{}{}ssh {} {} {}", INNER_CTL_READY, level > 0 ? "zstd -q -dc | " : "exec ",
+                      inner_opts(), target.node, escape_for_ssh(cmd))
+        : fmt::format("{}bash -c {}", level > 0 ? "zstd -q -dc | " : "exec ", escape_for_ssh(cmd));
+    auto consumer = base_args(false);
+    consumer.push_back(dtn_cmd);
+
+    std::vector<std::string> filter;
+    if (level > 0) filter = {"zstd", "-q", "-T0", fmt::format("-{}", level), "-c"};
+    auto st = run_from_writer(produce, filter, consumer, relay_timeout(raw_bytes));
+    if (!st.ok()) {
+        std::string why = !st.consumer.error.empty() ? st.consumer.error
+                        : !st.producer.error.empty() ? st.producer.error : st.err;
+        return Result<uint64_t>::Err(fmt::format("tar push failed: {}", why));
+    }
+    return Result<uint64_t>::Ok(st.bytes);
+}
+
+Result<void> SSH::push_stream(const std::string& node, const fs::path& base_dir,
+                              const std::vector<std::string>& files,
+                              const std::vector<std::string>& deleted,
+                              const std::string& remote_dir, int level, bool staged,
+                              uint64_t* wire_out) {
+    std::string dels;
+    uint64_t raw_bytes = 0;
+    for (const auto& f : files) {
+        std::error_code ec;
+        auto sz = fs::file_size(base_dir / f, ec);
+        if (!ec) raw_bytes += sz;
+    }
+    for (const auto& d : deleted) {
+        dels += d;
+        dels += '\0';
+    }
+
+    // The archive is written here, straight into the pipe
+    auto produce = [&](int fd) -> Result<uint64_t> {
+        TarWriter tar(fd);
+        auto r = tar.raw(std::to_string(dels.size()) + "\n" + dels);
+        for (size_t i = 0; i < files.size() && r.is_ok(); i++) {
+            r = tar.add(base_dir / files[i], files[i]);
+        }
+        if (r.is_ok() && staged) r = tar.add_empty(STAGE_END);
+        if (r.is_ok()) r = tar.finish();
+        if (r.is_err()) return Result<uint64_t>::Err(r.error);
+        return Result<uint64_t>::Ok(tar.bytes());
+    };
+
+    debug_log("ssh", fmt::format("→ tar push {} files ({} bytes), {} deletions level={}{}",
+                                 files.size(), raw_bytes, deleted.size(), level,
+                                 staged ? " staged" : ""));
+    auto t0 = std::chrono::steady_clock::now();
+    auto sent = relay_to(Target::compute(node), produce, apply_stream_cmd(remote_dir, staged), level, raw_bytes);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (sent.is_err()) return Result<void>::Err(sent.error);
+    debug_log("ssh", fmt::format("← tar push {} wire bytes in {:.2f}s", sent.value, secs));
+
+    // One stream of several says little about what a single one gets
+    if (wire_out) *wire_out = sent.value;
+    else record_transfer(host_, raw_bytes, sent.value, secs, level > 0);
+    return Result<void>::Ok();
+}
+
+// ── Parallel push ─────────────────────────────────────────
+// Files are sharded by size across several streams at once. Files of
+// PUSH_SPLIT_BYTES and up are cut into PUSH_CHUNK_BYTES pieces, each its
+// own stream: dd reads the piece here and dd writes it at its offset into
+// <file>.tccp-part on the node. Once every stream succeeded, one command
+// trims each part to size and renames it over the file. After a failure
+// the parts stay, so a resumed push only sends the missing pieces.
+//
+// Deletions ride on the first shard, together with any file whose path
+// runs into a deleted one (file became directory or back), so that file
+// can't land before the deletion.
+
+static constexpr uint64_t PARALLEL_MIN_BYTES = 64ull << 20;
+static constexpr uint64_t SHARD_MIN_BYTES = 16ull << 20;
+static constexpr uint64_t DD_BLOCK = 1 << 20;
+
+namespace {
+struct PushJob {
+    std::vector<std::string> files;   // a tar shard, or
+    std::string chunk_of;             // one piece of this file
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+    int level = 0;
+    bool carries_deletions = false;
+};
+
+// Whether a pushed path runs into a deleted one: a deleted directory
+// became this file, or a deleted file one of its parents.
+class DeletionClash {
+public:
+    explicit DeletionClash(const std::vector<std::string>& deleted)
+        : deleted_(deleted.begin(), deleted.end()) {
+        for (const auto& d : deleted) {
+            for (size_t p = d.find('/'); p != std::string::npos; p = d.find('/', p + 1)) {
+                parents_.insert(d.substr(0, p));
+            }
+        }
+    }
+
+    bool operator()(const std::string& f) const {
+        if (parents_.count(f)) return true;
+        for (size_t p = f.find('/'); p != std::string::npos; p = f.find('/', p + 1)) {
+            if (deleted_.count(f.substr(0, p))) return true;
+        }
+        return false;
+    }
+
+private:
+    std::set<std::string> deleted_, parents_;
+};
+} // namespace
+
+Result<void> SSH::push_parallel(const std::string& node, const fs::path& base_dir,
+                                const std::vector<std::string>& files,
+                                const std::vector<std::string>& deleted,
+                                const std::string& remote_dir, int level, int streams,
+                                PushProgress* progress) {
+    DeletionClash runs_into_deletion(deleted);
+
+    PushJob first;
+    first.carries_deletions = true;
+    first.level = level;
+    std::vector<PushJob> jobs;
+    std::vector<std::pair<uint64_t, std::string>> plain, packed;
+    std::vector<std::pair<std::string, uint64_t>> split;
+    for (const auto& f : files) {
+        std::error_code ec;
+        uint64_t size = fs::file_size(base_dir / f, ec);
+        if (ec) size = 0;
+        if (runs_into_deletion(f)) {
+            first.files.push_back(f);
+            first.bytes += size;
+        } else if (size >= PUSH_SPLIT_BYTES) {
+            split.emplace_back(f, size);
+            int chunk_level = is_precompressed(f) ? 0 : level;
+            const std::set<uint64_t>* have = nullptr;
+            if (progress) {
+                auto it = progress->have.find(f);
+                if (it != progress->have.end()) have = &it->second;
+            }
+            for (uint64_t off = 0; off < size; off += PUSH_CHUNK_BYTES) {
+                if (have && have->count(off)) continue;
+                PushJob j;
+                j.chunk_of = f;
+                j.offset = off;
+                j.bytes = std::min(PUSH_CHUNK_BYTES, size - off);
+                j.level = chunk_level;
+                jobs.push_back(std::move(j));
+            }
+        } else {
+            (level > 0 && is_precompressed(f) ? packed : plain).emplace_back(size, f);
+        }
+    }
+
+    // Largest first into the lightest shard
+    auto shard = [&](std::vector<std::pair<uint64_t, std::string>>& group, int group_level,
+                     PushJob* seed) {
+        if (group.empty()) return;
+        uint64_t total = 0;
+        for (const auto& g : group) total += g.first;
+        size_t n = static_cast<size_t>(std::min<uint64_t>(
+            streams, std::max<uint64_t>(1, total / SHARD_MIN_BYTES)));
+        std::vector<PushJob> shards(n);
+        for (auto& sh : shards) sh.level = group_level;
+        if (seed) shards[0] = std::move(*seed);
+        std::sort(group.begin(), group.end(), std::greater<>());
+        for (auto& g : group) {
+            auto lightest = std::min_element(shards.begin(), shards.end(),
+                [](const PushJob& a, const PushJob& b) { return a.bytes < b.bytes; });
+            lightest->files.push_back(std::move(g.second));
+            lightest->bytes += g.first;
+        }
+        for (auto& sh : shards) jobs.push_back(std::move(sh));
+    };
+    if (!plain.empty()) {
+        shard(plain, level, &first);
+        shard(packed, 0, nullptr);
+    } else if (!packed.empty()) {
+        first.level = 0;
+        shard(packed, 0, &first);
+    } else if (!first.files.empty() || !deleted.empty()) {
+        jobs.push_back(std::move(first));
+    }
+
+    // Biggest jobs start first so the tail is short
+    std::stable_sort(jobs.begin(), jobs.end(),
+                     [](const PushJob& a, const PushJob& b) { return a.bytes > b.bytes; });
+
+    debug_log("ssh", fmt::format("→ parallel push: {} files in {} jobs over {} streams, {} split",
+                                 files.size(), jobs.size(), streams, split.size()));
+    auto t0 = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> wire{0}, raw{0};
+    std::mutex err_mu;
+    std::string first_err;
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+            {
+                std::lock_guard<std::mutex> lock(err_mu);
+                if (!first_err.empty()) return;
+            }
+            const auto& job = jobs[i];
+            uint64_t sent = 0;
+            Result<void> r = Result<void>::Ok();
+            if (job.chunk_of.empty()) {
+                r = push_stream(node, base_dir, job.files,
+                                job.carries_deletions ? deleted : std::vector<std::string>{},
+                                remote_dir, job.level, false, &sent);
+            } else {
+                std::string rel_dir = fs::path(job.chunk_of).parent_path().generic_string();
+                auto produce = [&](int fd) -> Result<uint64_t> {
+                    auto r = send_file_range(fd, base_dir / job.chunk_of, job.offset, job.bytes);
+                    if (r.is_err()) return Result<uint64_t>::Err(r.error);
+                    return Result<uint64_t>::Ok(job.bytes);
+                };
+                std::string inner = fmt::format(
+                    "mkdir -p {0} && cd {0} && {1}dd of={2} bs={3} seek={4} conv=notrunc 2>/dev/null",
+                    remote_dir,
+                    rel_dir.empty() ? "" : fmt::format("mkdir -p {} && ", escape_for_ssh(rel_dir)),
+                    escape_for_ssh(job.chunk_of + PUSH_PART_SUFFIX), DD_BLOCK, job.offset / DD_BLOCK);
+                auto res = relay_to(Target::compute(node), produce, inner, job.level, job.bytes);
+                if (res.is_err()) r = Result<void>::Err(res.error);
+                else sent = res.value;
+            }
+            if (r.is_err()) {
+                std::lock_guard<std::mutex> lock(err_mu);
+                if (first_err.empty()) first_err = r.error;
+                return;
+            }
+            wire += sent;
+            raw += job.bytes;
+            if (progress && job.chunk_of.empty() && progress->file_sent) {
+                for (const auto& f : job.files) progress->file_sent(f);
+            } else if (progress && !job.chunk_of.empty() && progress->chunk_sent) {
+                progress->chunk_sent(job.chunk_of, job.offset);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < streams; i++) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+    if (!first_err.empty()) return Result<void>::Err(first_err);
+    if (!split.empty()) {
+        std::string cmd = fmt::format("cd {}", remote_dir);
+        for (const auto& [f, size] : split) {
+            std::string part = escape_for_ssh(f + PUSH_PART_SUFFIX);
+            cmd += fmt::format(" && truncate -s {} {} && mv -f {} {}", size, part, part, escape_for_ssh(f));
+        }
+        auto r = run_compute(node, cmd);
+        if (!r.ok()) return Result<void>::Err(fmt::format("reassembling split files failed: {}", trim(r.err)));
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    debug_log("ssh", fmt::format("← parallel push {} wire bytes in {:.2f}s", wire.load(), secs));
+    record_parallel(host_, streams, wire, secs);
+    return Result<void>::Ok();
+}
 
 Result<void> SSH::tar_push(const std::string& node, const fs::path& base_dir,
-                           const std::vector<std::string>& files, const std::string& remote_dir) {
-    if (files.empty()) return Result<void>::Ok();
+                           const std::vector<std::string>& files, const std::string& remote_dir,
+                           const std::vector<std::string>& deleted, bool staged,
+                           PushProgress* progress) {
+    if (files.empty() && deleted.empty()) return Result<void>::Ok();
+
+    auto level = transfer_level();
+    if (level.is_err()) return Result<void>::Err(level.error);
+
+    // Staging needs everything in one stream to commit at once. Otherwise
+    // split files go in chunks even over one stream, so they can resume.
+    if (!staged) {
+        uint64_t total = 0;
+        bool any_split = false;
+        for (const auto& f : files) {
+            std::error_code ec;
+            auto sz = fs::file_size(base_dir / f, ec);
+            if (ec) continue;
+            total += sz;
+            any_split |= sz >= PUSH_SPLIT_BYTES;
+        }
+        if (total >= PARALLEL_MIN_BYTES) {
+            auto streams = stream_count(streams_, load_link_stats(host_));
+            if (streams.is_err()) return Result<void>::Err(streams.error);
+            if (streams.value > 1 || any_split) {
+                return push_parallel(node, base_dir, files, deleted, remote_dir, level.value,
+                                     streams.value, progress);
+            }
+        }
+    }
+    if (level.value == 0 || staged) {
+        return push_stream(node, base_dir, files, deleted, remote_dir, level.value, staged);
+    }
 
-    // Build tar file list
-    std::string file_list;
+    // Already-compressed files go in a second, uncompressed stream alongside,
+    // unless they run into a deletion: only the first stream deletes
+    DeletionClash runs_into_deletion(deleted);
+    std::vector<std::string> plain, packed;
     for (const auto& f : files) {
-        file_list += escape_for_ssh(f) + " ";
-    }
-
-    // Pipeline: tar cf - files | ssh DTN 'exec ssh node "mkdir -p dir && cd dir && tar xf -"'
-    std::string inner_cmd = fmt::format("mkdir -p {} && cd {} && tar xf -", remote_dir, remote_dir);
-    std::string ssh_cmd = fmt::format("exec ssh {} {} {}",
-                                      SSH_OPTS, node, escape_for_ssh(inner_cmd));
-
-    // Build the full pipeline command
-    std::string pipeline = fmt::format(
-        "tar cf - -C {} {} | ssh -T"
-        " -o ControlMaster=auto"
-        " -o ControlPath={}"
-        " -o ControlPersist=yes"
-        " {}@{} {}",
-        base_dir.string(), file_list,
-        ctl_path_.string(),
-        user_, host_, escape_for_ssh(ssh_cmd));
-
-    // Run via shell to handle pipe
-    auto result = exec_capture({"sh", "-c", pipeline}, 600);
-    if (result.exit_code != 0) {
-        return Result<void>::Err(fmt::format("tar push failed: {}", result.err));
+        (is_precompressed(f) && !runs_into_deletion(f) ? packed : plain).push_back(f);
     }
+    if (packed.empty()) return push_stream(node, base_dir, plain, deleted, remote_dir, level.value, false);
+    if (plain.empty()) return push_stream(node, base_dir, packed, deleted, remote_dir, 0, false);
+
+    auto packed_done = std::async(std::launch::async, [&] {
+        return push_stream(node, base_dir, packed, {}, remote_dir, 0, false);
+    });
+    auto r = push_stream(node, base_dir, plain, deleted, remote_dir, level.value, false);
+    auto r2 = packed_done.get();
+    return r.is_err() ? r : r2;
+}
+
+Result<void> SSH::tar_to_command(const Target& target, const fs::path& base_dir,
+                                 const std::vector<std::string>& files, const std::string& cmd,
+                                 const std::vector<std::string>& names,
+                                 const std::atomic<bool>* stop) {
+    auto level = transfer_level();
+    if (level.is_err()) return Result<void>::Err(level.error);
+    uint64_t raw_bytes = 0;
+    std::vector<uint64_t> sizes(files.size(), 0);
+    for (size_t i = 0; i < files.size(); i++) {
+        std::error_code ec;
+        auto sz = fs::file_size(base_dir / files[i], ec);
+        if (!ec) sizes[i] = sz;
+        raw_bytes += sizes[i];
+    }
+    uint64_t added = 0;
+    auto produce = [&](int fd) -> Result<uint64_t> {
+        TarWriter tar(fd);
+        Result<void> r = Result<void>::Ok();
+        for (size_t i = 0; i < files.size() && r.is_ok(); i++) {
+            if (stop && *stop) {
+                debug_log("ssh", fmt::format("tar to command stopped after {} of {} files", i, files.size()));
+                break;
+            }
+            r = tar.add(base_dir / files[i], names.empty() ? files[i] : names[i]);
+            added += sizes[i];
+        }
+        if (r.is_ok()) r = tar.finish();
+        if (r.is_err()) return Result<uint64_t>::Err(r.error);
+        return Result<uint64_t>::Ok(tar.bytes());
+    };
+
+    debug_log("ssh", fmt::format("→ tar to command: {} files ({} bytes) level={}",
+                                 files.size(), raw_bytes, level.value));
+    auto t0 = std::chrono::steady_clock::now();
+    auto sent = relay_to(target, produce, cmd, level.value, raw_bytes);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (sent.is_err()) return Result<void>::Err(sent.error);
+    record_transfer(host_, added, sent.value, secs, level.value > 0);
     return Result<void>::Ok();
 }
 
 // ── Tar pull (DTN → local) ───────────────────────────────
 
-Result<void> SSH::tar_pull(const std::string& remote_dir, const fs::path& local_dir) {
+Result<void> SSH::tar_pull(const std::string& remote_dir, const fs::path& local_dir,
+                           const std::vector<std::string>& files) {
+    if (files.empty()) return Result<void>::Ok();
     fs::create_directories(local_dir);
 
-    std::string pipeline = fmt::format(
-        "ssh -T"
-        " -o ControlMaster=auto"
-        " -o ControlPath={}"
-        " -o ControlPersist=yes"
-        " {}@{} 'cd {} && tar cf - .' | tar xf - -C {}",
-        ctl_path_.string(),
-        user_, host_, remote_dir, local_dir.string());
+    auto level = transfer_level();
+    if (level.is_err()) return Result<void>::Err(level.error);
 
-    auto result = exec_capture({"sh", "-c", pipeline}, 600);
-    if (result.exit_code != 0) {
-        return Result<void>::Err(fmt::format("tar pull failed: {}", result.err));
+    // Names go to the remote tar on stdin, the archive is unpacked here
+    std::string names;
+    for (const auto& f : files) {
+        names += "./" + f;
+        names += '\0';
     }
+    auto producer = base_args(false);
+    producer.push_back(fmt::format("cd {} && tar cf - --null -T -{}", remote_dir,
+        level.value > 0 ? fmt::format(" | zstd -q -T0 -{} -c", level.value) : ""));
+    std::vector<std::string> filter;
+    if (level.value > 0) filter = {"zstd", "-q", "-dc"};
+    TarReader reader(local_dir);
+
+    debug_log("ssh", fmt::format("→ tar pull {} files from {} level={}", files.size(), remote_dir, level.value));
+    auto t0 = std::chrono::steady_clock::now();
+    auto st = run_to_reader(producer, names, filter,
+                            [&](const char* d, size_t n) { return reader.feed(d, n); }, 600);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    debug_log("ssh", fmt::format("← tar pull {} wire bytes, {} files in {:.2f}s",
+                                 st.bytes, reader.files(), secs));
+
+    if (!reader.error().empty()) return Result<void>::Err(fmt::format("tar pull failed: {}", reader.error()));
+    if (!st.ok()) {
+        std::string why = !st.consumer.error.empty() ? st.consumer.error
+                        : !st.producer.error.empty() ? st.producer.error : st.err;
+        return Result<void>::Err(fmt::format("tar pull failed: {}", why));
+    }
+    auto done = reader.finish();
+    if (done.is_err()) return Result<void>::Err(fmt::format("tar pull failed: {}", done.error));
+    // Raw size is unknown here, so only throughput is learned
+    record_transfer(host_, st.bytes, st.bytes, secs, false);
     return Result<void>::Ok();
 }
 
@@ -248,11 +878,14 @@ int SSH::interactive(const std::string& node, const std::string& cmd,
     }
 
     // Build inner ssh command with port forwarding
-    std::string inner = "ssh -t";
+    std::string inner = INNER_CTL_READY + "ssh -t";
     for (int port : ports) {
         inner += fmt::format(" -L {}:localhost:{}", port, port);
     }
-    inner += fmt::format(" {} {} {}", SSH_OPTS, node, escape_for_ssh(cmd));
+    // Forwards requested through a mux client outlive it in the master, so
+    // port-forwarding sessions get their own connection.
+    inner += fmt::format(" {} {} {}", ports.empty() ? inner_opts() : SSH_OPTS + " -o ControlPath=none",
+                         node, escape_for_ssh(cmd));
     args.push_back(inner);
 
     return exec_passthrough(args);
@@ -264,14 +897,15 @@ int SSH::login_shell() {
     auto args = base_args(true);
     // Inner: interactive ssh from DTN to login node with TTY + login shell.
     std::string inner = fmt::format(
-        "exec ssh -t {} {} 'exec $SHELL -l'", SSH_OPTS, login_);
+        "{}exec ssh -t {} {} 'exec $SHELL -l'", INNER_CTL_READY, inner_opts(), login_);
     args.push_back(inner);
     return exec_passthrough(args);
 }
 
 // ── Process execution ─────────────────────────────────────
 
-SSHResult SSH::exec_capture(const std::vector<std::string>& args, int timeout) {
+SSHResult SSH::exec_capture(const std::vector<std::string>& args, int timeout,
+                            const std::string* input) {
     SSHResult result{};
 
     auto t_start = std::chrono::steady_clock::now();
@@ -284,93 +918,31 @@ SSHResult SSH::exec_capture(const std::vector<std::string>& args, int timeout) {
         debug_log("ssh", fmt::format("→ (timeout={}s) {}", timeout, debug_truncate(joined, 8000)));
     }
 
-    int stdout_pipe[2], stderr_pipe[2];
-    if (pipe(stdout_pipe) != 0 || pipe(stderr_pipe) != 0) {
-        result.exit_code = -1;
-        result.err = "pipe() failed";
-        return result;
+    ProcIO io;
+    io.on_stdout = [&](const char* d, size_t n) { result.out.append(d, n); };
+    io.on_stderr = [&](const char* d, size_t n) { result.err.append(d, n); };
+    size_t in_off = 0;
+    if (input) {
+        io.stdin_source = [&](char* buf, size_t cap) -> ssize_t {
+            size_t n = std::min(cap, input->size() - in_off);
+            std::memcpy(buf, input->data() + in_off, n);
+            in_off += n;
+            return static_cast<ssize_t>(n);
+        };
     }
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        result.exit_code = -1;
-        result.err = "fork() failed";
-        close(stdout_pipe[0]); close(stdout_pipe[1]);
-        close(stderr_pipe[0]); close(stderr_pipe[1]);
-        return result;
-    }
-
-    if (pid == 0) {
-        // Child
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
-
-        std::vector<const char*> argv;
-        for (const auto& a : args) argv.push_back(a.c_str());
-        argv.push_back(nullptr);
-
-        execvp(argv[0], const_cast<char* const*>(argv.data()));
-        _exit(127);
-    }
-
-    // Parent
-    close(stdout_pipe[1]);
-    close(stderr_pipe[1]);
-
-    // Read stdout and stderr
-    auto read_fd = [](int fd) -> std::string {
-        std::string data;
-        char buf[4096];
-        ssize_t n;
-        while ((n = read(fd, buf, sizeof(buf))) > 0) {
-            data.append(buf, n);
-        }
-        return data;
-    };
-
-    // Simple: read both (could use select for large output, but this works for our use)
-    result.out = read_fd(stdout_pipe[0]);
-    result.err = read_fd(stderr_pipe[0]);
-    close(stdout_pipe[0]);
-    close(stderr_pipe[0]);
+    auto st = run_process(args, io, timeout);
 
     // Trim trailing whitespace from output
     while (!result.out.empty() && (result.out.back() == '\n' || result.out.back() == '\r'))
         result.out.pop_back();
 
-    int status;
-    // Wait with timeout
-    if (timeout > 0) {
-        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
-        while (true) {
-            int ret = waitpid(pid, &status, WNOHANG);
-            if (ret > 0) break;
-            if (ret < 0) {
-                result.exit_code = -1;
-                result.err = "waitpid() failed";
-                return result;
-            }
-            if (std::chrono::steady_clock::now() >= deadline) {
-                kill(pid, SIGTERM);
-                sleep_ms(500);
-                kill(pid, SIGKILL);
-                waitpid(pid, &status, 0);
-                result.exit_code = -1;
-                result.err = "command timed out";
-                return result;
-            }
-            sleep_ms(50);
-        }
-    } else {
-        waitpid(pid, &status, 0);
+    result.exit_code = st.exit_code;
+    if (!st.error.empty()) {
+        result.exit_code = -1;
+        result.err = st.error;
+        return result;
     }
 
-    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-
     if (debug_enabled()) {
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - t_start).count();
@@ -403,3 +975,29 @@ int SSH::exec_passthrough(const std::vector<std::string>& args) {
 }
 
 #endif
+
+// ── Async variants ────────────────────────────────────────
+
+std::future<SSHResult> SSH::run_async(const std::string& cmd, int timeout) {
+    return std::async(std::launch::async, [this, cmd, timeout] { return run(cmd, timeout); });
+}
+
+std::future<SSHResult> SSH::run_login_async(const std::string& cmd, int timeout) {
+    return std::async(std::launch::async, [this, cmd, timeout] { return run_login(cmd, timeout); });
+}
+
+std::future<SSHResult> SSH::run_compute_async(const std::string& node, const std::string& cmd,
+                                              int timeout) {
+    return std::async(std::launch::async, [this, node, cmd, timeout] {
+        return run_compute(node, cmd, timeout);
+    });
+}
+
+std::future<Result<void>> SSH::tar_push_async(const std::string& node, const fs::path& base_dir,
+                                              std::vector<std::string> files,
+                                              const std::string& remote_dir) {
+    return std::async(std::launch::async,
+        [this, node, base_dir, files = std::move(files), remote_dir] {
+            return tar_push(node, base_dir, files, remote_dir);
+        });
+}
@@ -1,24 +1,117 @@
 #pragma once
 
 #include "types.hpp"
+#include "proc.hpp"
+#include <atomic>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+class Agent;
+
+// Where a remote command runs. Login and compute are reached via the DTN.
+struct Target {
+    enum class Hop { DTN, Login, Compute };
+    Hop hop = Hop::DTN;
+    std::string node;
+
+    static Target dtn() { return {Hop::DTN, ""}; }
+    static Target login() { return {Hop::Login, ""}; }
+    static Target compute(const std::string& node) { return {Hop::Compute, node}; }
+};
+
+// Pushes of a large file are cut into PUSH_CHUNK_BYTES pieces, each
+// written at its offset into <file>.tccp-part on the node.
+constexpr uint64_t PUSH_CHUNK_BYTES = 64ull << 20;
+constexpr uint64_t PUSH_SPLIT_BYTES = 2 * PUSH_CHUNK_BYTES;
+constexpr const char* PUSH_PART_SUFFIX = ".tccp-part";
+
+// What a resumed tar_push may skip, and where it reports progress (see
+// PushJournal). The callbacks run on worker threads.
+struct PushProgress {
+    std::map<std::string, std::set<uint64_t>> have;  // file → chunk offsets on the node
+    std::function<void(const std::string& file)> file_sent;
+    std::function<void(const std::string& file, uint64_t offset)> chunk_sent;
+};
 
 class SSH {
 public:
     SSH(std::string host, std::string login, std::string user, std::string password);
+    ~SSH();
 
     Result<void> connect();
     void disconnect();
 
+    // Tear down the persistent DTN → node master (inner hop).
+    void close_inner(const std::string& node);
+
     SSHResult run(const std::string& cmd, int timeout = 300);
     SSHResult run_login(const std::string& cmd, int timeout = 300);
     SSHResult run_compute(const std::string& node, const std::string& cmd, int timeout = 300);
+    SSHResult run_on(const Target& target, const std::string& cmd, int timeout = 300);
 
+    // Asynchronous variants: each runs on its own thread and multiplexes over
+    // the same ControlMaster, so independent remote steps overlap.
+    std::future<SSHResult> run_async(const std::string& cmd, int timeout = 300);
+    std::future<SSHResult> run_login_async(const std::string& cmd, int timeout = 300);
+    std::future<SSHResult> run_compute_async(const std::string& node, const std::string& cmd,
+                                             int timeout = 300);
+
+    // Run independent commands on one target in a single round trip. The
+    // script is sent over stdin; each command runs in its own subshell with
+    // stdin from /dev/null, and results come back in command order.
+    std::vector<SSHResult> run_batch(const Target& target,
+                                     const std::vector<std::string>& cmds, int timeout = 300);
+
+    // Run cmd on target and hand output to io's sinks as it arrives; out/err
+    // in the result stay empty. Sinks run on the reading thread, so a slow
+    // consumer stalls the pipe and, through ssh, the remote command.
+    // Without io.stdin_source the command's stdin is empty.
+    SSHResult run_streaming(const Target& target, const std::string& cmd,
+                            ProcIO io, int timeout = 0);
+
+    // Run cmd on target with input fed to its stdin.
+    SSHResult run_with_input(const Target& target, const std::string& cmd,
+                             const std::string& input, int timeout = 300);
+
+    // Start cmd on target as a long-lived child whose stdio is the channel.
+    Result<void> open_channel(const Target& target, const std::string& cmd, Process& proc);
+
+    // Remote helper agent for target, started on first use and kept for the
+    // lifetime of this SSH object (see agent.hpp).
+    Agent& agent(const Target& target);
+
+    // tar transfer compression: "auto", "off" or a zstd level (see compress.hpp).
+    void set_compression(const std::string& setting) { compression_ = setting; }
+    // Parallel streams for large pushes: "auto" or a count (see compress.hpp).
+    void set_streams(const std::string& setting) { streams_ = setting; }
+
+    // deleted paths are removed on the node first, in the same stream.
+    // staged: extract aside and move into place only once all of it arrived.
     Result<void> tar_push(const std::string& node, const fs::path& base_dir,
-                          const std::vector<std::string>& files, const std::string& remote_dir);
-    Result<void> tar_pull(const std::string& remote_dir, const fs::path& local_dir);
+                          const std::vector<std::string>& files, const std::string& remote_dir,
+                          const std::vector<std::string>& deleted = {}, bool staged = false,
+                          PushProgress* progress = nullptr);
+    // files (relative to base_dir) as one tar stream into cmd on target
+    // (DTN or compute), which reads the archive from stdin. names, if
+    // given, are the member names to store the files under. Once stop is
+    // set the archive ends after the file being sent.
+    Result<void> tar_to_command(const Target& target, const fs::path& base_dir,
+                                const std::vector<std::string>& files, const std::string& cmd,
+                                const std::vector<std::string>& names = {},
+                                const std::atomic<bool>* stop = nullptr);
+    // files are relative to remote_dir.
+    Result<void> tar_pull(const std::string& remote_dir, const fs::path& local_dir,
+                          const std::vector<std::string>& files);
+    std::future<Result<void>> tar_push_async(const std::string& node, const fs::path& base_dir,
+                                             std::vector<std::string> files,
+                                             const std::string& remote_dir);
 
     int interactive(const std::string& node, const std::string& cmd,
                     const std::vector<int>& ports = {});
@@ -29,10 +122,43 @@ public:
 private:
     std::string host_, login_, user_, password_;
     fs::path ctl_path_;
+    std::map<std::string, std::unique_ptr<Agent>> agents_;
+    std::mutex agents_mu_;
+    std::string compression_ = "auto";
+    std::string streams_ = "auto";
+    int zstd_ok_ = -1;          // -1 = not probed yet
+    std::mutex zstd_mu_;
 
     std::vector<std::string> base_args(bool tty = false) const;
-    SSHResult exec_capture(const std::vector<std::string>& args, int timeout);
+    // Full argv for running cmd on target. With stdin, the inner hop forwards
+    // our stdin instead of reading /dev/null.
+    std::vector<std::string> remote_args(const Target& target, const std::string& cmd,
+                                         bool with_stdin = false) const;
+    SSHResult exec_capture(const std::vector<std::string>& args, int timeout,
+                           const std::string* input = nullptr);
     int exec_passthrough(const std::vector<std::string>& args);
+
+    // zstd level for the next tar stream; 0 when off or zstd is missing
+    // on either end.
+    Result<int> transfer_level();
+    bool zstd_available();
+    // One tar stream. With wire_out, its wire bytes go there instead of
+    // into the link stats.
+    Result<void> push_stream(const std::string& node, const fs::path& base_dir,
+                             const std::vector<std::string>& files,
+                             const std::vector<std::string>& deleted,
+                             const std::string& remote_dir, int level, bool staged,
+                             uint64_t* wire_out = nullptr);
+    Result<void> push_parallel(const std::string& node, const fs::path& base_dir,
+                               const std::vector<std::string>& files,
+                               const std::vector<std::string>& deleted,
+                               const std::string& remote_dir, int level, int streams,
+                               PushProgress* progress);
+    // produce's stream (zstd'd at level) to cmd on the DTN or, through
+    // it, a compute node. Returns the wire bytes. raw_bytes sizes the
+    // timeout.
+    Result<uint64_t> relay_to(const Target& target, const StreamWriter& produce,
+                              const std::string& cmd, int level, uint64_t raw_bytes);
 };
 
 std::string escape_for_ssh(const std::string& cmd);
@@ -1,15 +1,243 @@
 #include "state.hpp"
+#include "hash.hpp"
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char MANIFEST_MAGIC[8] = {'T', 'C', 'C', 'P', 'M', 'A', 'N', '\0'};
+static constexpr uint32_t MANIFEST_VERSION = 1;
+static constexpr size_t MANIFEST_HEADER = 32;
+static constexpr size_t RECORD_HEAD = 32;
 
 StateStore::StateStore(const std::string& project_name) {
     state_path_ = home_dir() / ".tccp" / "projects" / project_name / "session.yaml";
+    manifest_path_ = state_path_.parent_path() / "manifest.bin";
+    pulled_path_ = state_path_.parent_path() / "pulled.bin";
+    journal_path_ = state_path_.parent_path() / "push.journal";
 }
 
 bool StateStore::exists() const {
     return fs::exists(state_path_);
 }
 
+// ── File helpers ──────────────────────────────────────────
+
+namespace {
+
+void put_le(std::string& b, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) b.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+uint64_t get_le(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+// Replace path with data so readers see either the old or the new file.
+bool write_atomic(const fs::path& path, const std::string& data) {
+    fs::path tmp = path;
+    tmp += ".tmp";
+#ifdef _WIN32
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+#else
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        off += static_cast<size_t>(n);
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    // Make the rename itself durable
+    int dfd = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+    return true;
+#endif
+}
+
+// Read-only view of a whole file: mapped where we can, else read in.
+struct FileView {
+    const unsigned char* p = nullptr;
+    size_t len = 0;
+    bool ok = false;
+#ifdef _WIN32
+    std::string buf;
+    explicit FileView(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return;
+        buf.assign(std::istreambuf_iterator<char>(in), {});
+        p = reinterpret_cast<const unsigned char*>(buf.data());
+        len = buf.size();
+        ok = true;
+    }
+#else
+    void* map = nullptr;
+    explicit FileView(const fs::path& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            len = static_cast<size_t>(st.st_size);
+            map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                p = static_cast<const unsigned char*>(map);
+                ok = true;
+            } else {
+                map = nullptr;
+            }
+        }
+        ::close(fd);
+    }
+    ~FileView() {
+        if (map) munmap(map, len);
+    }
+#endif
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+};
+
+} // namespace
+
+// ── Manifest ──────────────────────────────────────────────
+
+bool StateStore::read_manifest(const fs::path& file, std::vector<ManifestEntry>& out,
+                               uint64_t& last_sum) {
+    FileView f(file);
+    if (!f.ok || f.len < MANIFEST_HEADER) return false;
+    if (std::memcmp(f.p, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0) return false;
+    if (get_le(f.p + 8, 4) != MANIFEST_VERSION) return false;
+    uint64_t count = get_le(f.p + 12, 4);
+    uint64_t body_len = get_le(f.p + 16, 8);
+    uint64_t sum = get_le(f.p + 24, 8);
+    const unsigned char* body = f.p + MANIFEST_HEADER;
+    if (body_len != f.len - MANIFEST_HEADER || xxh64(body, body_len) != sum) return false;
+
+    std::vector<ManifestEntry> entries;
+    entries.reserve(count);
+    std::string path;
+    const unsigned char* p = body;
+    const unsigned char* end = body + body_len;
+    for (uint64_t i = 0; i < count; i++) {
+        if (static_cast<size_t>(end - p) < RECORD_HEAD) return false;
+        uint64_t shared = get_le(p, 4);
+        uint64_t suffix = get_le(p + 4, 4);
+        if (shared > path.size() || static_cast<size_t>(end - p) - RECORD_HEAD < suffix) return false;
+        ManifestEntry e;
+        e.mtime = static_cast<int64_t>(get_le(p + 8, 8));
+        e.size = static_cast<int64_t>(get_le(p + 16, 8));
+        e.hash = get_le(p + 24, 8);
+        path.resize(shared);
+        path.append(reinterpret_cast<const char*>(p + RECORD_HEAD), suffix);
+        e.path = path;
+        entries.push_back(std::move(e));
+        p += RECORD_HEAD + suffix;
+    }
+    if (p != end) return false;
+    out = std::move(entries);
+    last_sum = sum;
+    return true;
+}
+
+// Body checksum from the file's header, 0 if unreadable. Another tccp
+// process may have replaced the file since we last touched it.
+uint64_t StateStore::on_disk_sum(const fs::path& file) {
+    unsigned char h[MANIFEST_HEADER];
+    std::ifstream in(file, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(h), sizeof(h))) return 0;
+    if (std::memcmp(h, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0) return 0;
+    return get_le(h + 24, 8);
+}
+
+void StateStore::write_manifest(const fs::path& file, const std::vector<ManifestEntry>& manifest,
+                                uint64_t& last_sum) {
+    std::error_code ec;
+    if (manifest.empty()) {
+        fs::remove(file, ec);
+        last_sum = 0;
+        return;
+    }
+
+    std::vector<const ManifestEntry*> sorted;
+    sorted.reserve(manifest.size());
+    for (const auto& e : manifest) sorted.push_back(&e);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const ManifestEntry* a, const ManifestEntry* b) { return a->path < b->path; });
+
+    std::string body;
+    const std::string* prev = nullptr;
+    for (const auto* e : sorted) {
+        size_t shared = 0;
+        if (prev) {
+            size_t n = std::min(prev->size(), e->path.size());
+            while (shared < n && (*prev)[shared] == e->path[shared]) shared++;
+        }
+        put_le(body, shared, 4);
+        put_le(body, e->path.size() - shared, 4);
+        put_le(body, static_cast<uint64_t>(e->mtime), 8);
+        put_le(body, static_cast<uint64_t>(e->size), 8);
+        put_le(body, e->hash, 8);
+        body.append(e->path, shared, std::string::npos);
+        prev = &e->path;
+    }
+
+    uint64_t sum = xxh64(body.data(), body.size());
+    if (sum == last_sum && on_disk_sum(file) == sum) return;  // unchanged
+
+    std::string data(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    put_le(data, MANIFEST_VERSION, 4);
+    put_le(data, sorted.size(), 4);
+    put_le(data, body.size(), 8);
+    put_le(data, sum, 8);
+    data += body;
+    if (write_atomic(file, data)) last_sum = sum;
+}
+
+std::vector<ManifestEntry> StateStore::load_pulled() {
+    std::vector<ManifestEntry> pulled;
+    read_manifest(pulled_path_, pulled, pulled_sum_);
+    return pulled;
+}
+
+void StateStore::save_pulled(const std::vector<ManifestEntry>& pulled) {
+    fs::create_directories(pulled_path_.parent_path());
+    write_manifest(pulled_path_, pulled, pulled_sum_);
+}
+
+// ── Load / save ───────────────────────────────────────────
+
 SessionState StateStore::load() {
     SessionState state;
 
@@ -25,12 +253,14 @@ SessionState StateStore::load() {
         state.container_sif = root["container_sif"].as<std::string>("");
         state.started_at = root["started_at"].as<std::string>("");
 
-        if (root["manifest"] && root["manifest"].IsSequence()) {
+        if (!read_manifest(manifest_path_, state.manifest, manifest_sum_) && root["manifest"] && root["manifest"].IsSequence()) {
+            // Written before manifest.bin existed; the next save moves it over
             for (const auto& n : root["manifest"]) {
                 ManifestEntry e;
                 e.path = n["path"].as<std::string>("");
                 e.mtime = n["mtime"].as<int64_t>(0);
                 e.size = n["size"].as<int64_t>(0);
+                e.hash = parse_hash_hex(n["hash"].as<std::string>(""));
                 state.manifest.push_back(e);
             }
         }
@@ -44,6 +274,9 @@ SessionState StateStore::load() {
 void StateStore::save(const SessionState& state) {
     fs::create_directories(state_path_.parent_path());
 
+    // The manifest first: session.yaml is what marks a session as live
+    write_manifest(manifest_path_, state.manifest, manifest_sum_);
+
     YAML::Emitter out;
     out << YAML::BeginMap;
     out << YAML::Key << "slurm_id" << YAML::Value << state.slurm_id;
@@ -53,26 +286,81 @@ void StateStore::save(const SessionState& state) {
     out << YAML::Key << "container_uri" << YAML::Value << state.container_uri;
     out << YAML::Key << "container_sif" << YAML::Value << state.container_sif;
     out << YAML::Key << "started_at" << YAML::Value << state.started_at;
+    out << YAML::EndMap;
+
+    write_atomic(state_path_, std::string(out.c_str()) + "\n");
+}
 
-    if (!state.manifest.empty()) {
-        out << YAML::Key << "manifest" << YAML::Value << YAML::BeginSeq;
-        for (const auto& e : state.manifest) {
-            out << YAML::BeginMap;
-            out << YAML::Key << "path" << YAML::Value << e.path;
-            out << YAML::Key << "mtime" << YAML::Value << e.mtime;
-            out << YAML::Key << "size" << YAML::Value << e.size;
-            out << YAML::EndMap;
+void StateStore::clear() {
+    std::error_code ec;
+    fs::remove(state_path_, ec);
+    fs::remove(manifest_path_, ec);
+    fs::remove(journal_path_, ec);
+    manifest_sum_ = 0;
+}
+
+// ── Push journal ──────────────────────────────────────────
+
+PushJournal::PushJournal(const std::string& project_name, std::string node, std::string scratch)
+    : node_(std::move(node)), scratch_(std::move(scratch)) {
+    path_ = home_dir() / ".tccp" / "projects" / project_name / "push.journal";
+}
+
+std::vector<PushJournal::Entry> PushJournal::load() const {
+    std::vector<Entry> entries;
+    std::ifstream in(path_);
+    std::string line;
+    if (!std::getline(in, line) || line != "T " + node_ + " " + scratch_) return entries;
+    while (std::getline(in, line)) {
+        // A line cut short by a crash has no path, or a bad kind
+        size_t a = line.find(' ');
+        size_t b = a == std::string::npos ? a : line.find(' ', a + 1);
+        size_t c = b == std::string::npos ? b : line.find(' ', b + 1);
+        if (c == std::string::npos || c + 1 >= line.size() || a != 1) continue;
+        if (line[0] != 'F' && line[0] != 'C') continue;
+        Entry e;
+        e.chunk = line[0] == 'C';
+        e.hash = parse_hash_hex(line.substr(a + 1, b - a - 1));
+        try {
+            e.offset = std::stoull(line.substr(b + 1, c - b - 1));
+        } catch (...) {
+            continue;
         }
-        out << YAML::EndSeq;
+        e.path = line.substr(c + 1);
+        if (e.hash != 0) entries.push_back(std::move(e));
+    }
+    return entries;
+}
+
+void PushJournal::append(char kind, const std::string& path, uint64_t hash, uint64_t offset) {
+    if (path.find('\n') != std::string::npos) return;  // not worth a format for
+    std::lock_guard<std::mutex> lock(mu_);
+    std::error_code ec;
+    fs::create_directories(path_.parent_path(), ec);
+    // A journal for another node or scratch is replaced on first write
+    std::string header = "T " + node_ + " " + scratch_;
+    bool fresh = false;
+    if (!checked_) {
+        checked_ = true;
+        std::ifstream in(path_);
+        std::string first;
+        fresh = !std::getline(in, first) || first != header;
     }
+    std::ofstream out(path_, fresh ? std::ios::trunc : std::ios::app);
+    if (fresh) out << header << '\n';
+    out << kind << ' ' << hash_hex(hash) << ' ' << offset << ' ' << path << '\n';
+}
 
-    out << YAML::EndMap;
+void PushJournal::file_sent(const std::string& path, uint64_t hash) {
+    append('F', path, hash, 0);
+}
 
-    std::ofstream fout(state_path_.string());
-    fout << out.c_str();
+void PushJournal::chunk_sent(const std::string& path, uint64_t hash, uint64_t offset) {
+    append('C', path, hash, offset);
 }
 
-void StateStore::clear() {
+void PushJournal::clear() {
+    std::lock_guard<std::mutex> lock(mu_);
     std::error_code ec;
-    fs::remove(state_path_, ec);
+    fs::remove(path_, ec);
 }
@@ -1,7 +1,23 @@
 #pragma once
 
 #include "types.hpp"
+#include <mutex>
 #include <string>
+#include <vector>
+
+// ── Session state ─────────────────────────────────────────
+// session.yaml holds the scalar fields. The sync manifest, which can run
+// to 100k+ entries, lives next to it in manifest.bin:
+//
+//   header  "TCCPMAN\0", u32 version, u32 count, u64 body bytes, u64 XXH64(body)
+//   body    count records sorted by path, each
+//           u32 shared, u32 suffix, i64 mtime, i64 size, u64 hash, suffix bytes
+//
+// where a path is the first `shared` bytes of the previous one plus
+// `suffix`. Integers are little-endian. pulled.bin, in the same format,
+// lists the output files as of the last pull. All three files are
+// replaced atomically (write, fsync, rename), so a crash leaves the old
+// or the new state.
 
 class StateStore {
 public:
@@ -9,9 +25,69 @@ public:
 
     SessionState load();
     void save(const SessionState& state);
+    // Also drops the push journal: what it describes belongs to the session.
     void clear();
     bool exists() const;
+    const fs::path& path() const { return state_path_; }
+
+    // Output files last pulled (see Sync::pull_output). Not removed by
+    // clear(): the output directory outlives the session.
+    std::vector<ManifestEntry> load_pulled();
+    void save_pulled(const std::vector<ManifestEntry>& pulled);
 
 private:
     fs::path state_path_;
+    fs::path manifest_path_;
+    fs::path pulled_path_;
+    fs::path journal_path_;
+    // Body checksums last read or written, to skip rewrites
+    uint64_t manifest_sum_ = 0;
+    uint64_t pulled_sum_ = 0;
+
+    static bool read_manifest(const fs::path& file, std::vector<ManifestEntry>& out,
+                              uint64_t& last_sum);
+    static void write_manifest(const fs::path& file, const std::vector<ManifestEntry>& manifest,
+                               uint64_t& last_sum);
+    static uint64_t on_disk_sum(const fs::path& file);
+};
+
+// ── Push journal ──────────────────────────────────────────
+// push.journal records what an unfinished push already delivered, one
+// line per piece as it lands on the node:
+//
+//   T <node> <scratch>         first line: where the pieces went
+//   F <hash> 0 <path>          a whole file (its tar stream completed)
+//   C <hash> <offset> <path>   one chunk of a split file (ssh.hpp)
+//
+// where hash is the file's XXH64 at the time. A push that dies or times
+// out leaves the journal behind; the next one to the same node and
+// scratch checks it against the node and skips what is still there
+// (Sync::push). It is removed once a push completes, and with the
+// session (StateStore::clear).
+
+class PushJournal {
+public:
+    struct Entry {
+        bool chunk = false;
+        uint64_t hash = 0;
+        uint64_t offset = 0;
+        std::string path;
+    };
+
+    PushJournal(const std::string& project_name, std::string node, std::string scratch);
+
+    // Empty unless the journal was written for this node and scratch.
+    std::vector<Entry> load() const;
+    // Appended and flushed right away; safe from several threads.
+    void file_sent(const std::string& path, uint64_t hash);
+    void chunk_sent(const std::string& path, uint64_t hash, uint64_t offset);
+    void clear();
+
+private:
+    fs::path path_;
+    std::string node_, scratch_;
+    std::mutex mu_;
+    bool checked_ = false;   // header verified (or written) by this instance
+
+    void append(char kind, const std::string& path, uint64_t hash, uint64_t offset);
 };
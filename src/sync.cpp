@@ -1,5 +1,18 @@
 #include "sync.hpp"
+#include "agent.hpp"
+#include "hash.hpp"
+#include "delta.hpp"
+#include "debug.hpp"
+#include "state.hpp"
 #include <fmt/format.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <future>
+#include <thread>
 #include <fstream>
 #include <algorithm>
 #include <set>
@@ -9,42 +22,18 @@
 
 GitignoreParser::GitignoreParser(const fs::path& project_dir,
                                  std::vector<std::string> force_includes)
-    : project_dir_(project_dir), force_includes_(std::move(force_includes)) {
-    for (auto& fi : force_includes_) {
-        while (!fi.empty() && fi.back() == '/') fi.pop_back();
-        std::replace(fi.begin(), fi.end(), '\\', '/');
+    : project_dir_(project_dir) {
+    auto root = std::make_shared<Scope>();
+    for (auto& fi : force_includes) {
+        root->matcher.force_include(std::move(fi));
     }
-    add_default_patterns();
-    load_gitignore();
+    add_default_patterns(root->matcher);
+    load_ignore_file(project_dir_, root->matcher);
+    root->matcher.compile();
+    root_ = root;
 }
 
-bool GitignoreParser::is_force_included(const std::string& rel_path) const {
-    for (const auto& fi : force_includes_) {
-        if (fi.empty()) continue;
-        if (rel_path == fi) return true;
-        if (rel_path.size() > fi.size() && rel_path.compare(0, fi.size(), fi) == 0
-            && rel_path[fi.size()] == '/') return true;
-    }
-    return false;
-}
-
-void GitignoreParser::add_pattern(const std::string& raw, bool is_negation) {
-    Pattern pat;
-    pat.raw = raw;
-    pat.is_negation = is_negation;
-    pat.is_dir = !raw.empty() && raw.back() == '/';
-    pat.has_glob = raw.find('*') != std::string::npos || raw.find('?') != std::string::npos;
-    if (pat.has_glob) {
-        try {
-            pat.compiled = std::regex(glob_to_regex(raw));
-        } catch (...) {
-            pat.has_glob = false;
-        }
-    }
-    patterns_.push_back(std::move(pat));
-}
-
-void GitignoreParser::add_default_patterns() {
+void GitignoreParser::add_default_patterns(IgnoreMatcher& m) {
     std::vector<std::string> defaults = {
         ".git/",
         ".gitignore",
@@ -75,16 +64,17 @@ void GitignoreParser::add_default_patterns() {
     };
 
     for (const auto& pattern : defaults) {
-        add_pattern(pattern, false);
+        m.add(pattern, false);
     }
 }
 
-void GitignoreParser::load_gitignore() {
-    fs::path gitignore_path = project_dir_ / ".tccpignore";
+// .tccpignore if the directory has one, else .gitignore.
+bool GitignoreParser::load_ignore_file(const fs::path& dir, IgnoreMatcher& m) {
+    fs::path gitignore_path = dir / ".tccpignore";
     if (!fs::exists(gitignore_path)) {
-        gitignore_path = project_dir_ / ".gitignore";
+        gitignore_path = dir / ".gitignore";
     }
-    if (!fs::exists(gitignore_path)) return;
+    if (!fs::exists(gitignore_path)) return false;
 
     std::ifstream file(gitignore_path);
     std::string line;
@@ -98,57 +88,67 @@ void GitignoreParser::load_gitignore() {
             is_negation = true;
             line = line.substr(1);
         }
-        add_pattern(line, is_negation);
+        m.add(line, is_negation);
     }
+    return true;
 }
 
-bool GitignoreParser::is_ignored(const std::string& path) const {
-    return is_ignored(fs::path(path));
+std::shared_ptr<const GitignoreParser::Scope> GitignoreParser::enter(
+        const std::shared_ptr<const Scope>& parent, const fs::path& dir, const std::string& rel_dir) {
+    auto scope = std::make_shared<Scope>();
+    if (!load_ignore_file(dir, scope->matcher) || scope->matcher.empty()) return parent;
+    scope->parent = parent;
+    scope->base = rel_dir;
+    scope->matcher.compile();
+    return scope;
 }
 
-bool GitignoreParser::is_ignored(const fs::path& path) const {
+std::shared_ptr<const GitignoreParser::Scope> GitignoreParser::scope_for(const std::string& rel_dir) const {
+    if (rel_dir.empty()) return root_;
     {
-        auto rel = get_relative_path(path).generic_string();
-        if (is_force_included(rel)) return false;
+        std::lock_guard<std::mutex> lock(scopes_mu_);
+        auto it = scopes_.find(rel_dir);
+        if (it != scopes_.end()) return it->second;
     }
-    std::string rel_path = get_relative_path(path).string();
-    std::replace(rel_path.begin(), rel_path.end(), '\\', '/');
+    auto slash = rel_dir.rfind('/');
+    auto parent = scope_for(slash == std::string::npos ? "" : rel_dir.substr(0, slash));
+    auto scope = enter(parent, project_dir_ / rel_dir, rel_dir);
+    std::lock_guard<std::mutex> lock(scopes_mu_);
+    return scopes_.emplace(rel_dir, scope).first->second;
+}
 
-    bool ignored = false;
-    for (const auto& pat : patterns_) {
-        if (matches_pattern(rel_path, pat)) {
-            ignored = !pat.is_negation;
+bool GitignoreParser::decide(const Scope* scope, const std::string& rel, bool dir) const {
+    if (root_->matcher.is_forced(rel, dir)) return false;
+    // The deepest scope with an opinion wins
+    for (const Scope* s = scope; s; s = s->parent.get()) {
+        IgnoreMatcher::Verdict v;
+        if (s->base.empty()) {
+            v = dir ? s->matcher.dir_match(rel) : s->matcher.match(rel);
+        } else {
+            std::string local = rel.substr(s->base.size() + 1);
+            v = dir ? s->matcher.dir_match(local) : s->matcher.match(local);
         }
+        if (v != IgnoreMatcher::Verdict::None) return v == IgnoreMatcher::Verdict::Ignored;
     }
-    return ignored;
+    return false;
+}
+
+bool GitignoreParser::is_ignored(const std::string& path) const {
+    return is_ignored(fs::path(path));
+}
+
+bool GitignoreParser::is_ignored(const fs::path& path) const {
+    std::string rel_path = get_relative_path(path).string();
+    std::replace(rel_path.begin(), rel_path.end(), '\\', '/');
+    auto slash = rel_path.rfind('/');
+    auto scope = scope_for(slash == std::string::npos ? "" : rel_path.substr(0, slash));
+    return decide(scope.get(), rel_path, false);
 }
 
 bool GitignoreParser::is_dir_ignored(const std::string& rel_dir) const {
-    if (is_force_included(rel_dir)) return false;
-    for (const auto& fi : force_includes_) {
-        if (fi.size() > rel_dir.size() && fi.compare(0, rel_dir.size(), rel_dir) == 0
-            && fi[rel_dir.size()] == '/') return false;
-    }
-    bool ignored = false;
-    for (const auto& pat : patterns_) {
-        if (pat.is_negation) {
-            if (matches_pattern(rel_dir, pat)) ignored = false;
-            continue;
-        }
-        if (pat.is_dir) {
-            std::string pat_name = pat.raw.substr(0, pat.raw.size() - 1);
-            if (rel_dir == pat_name || rel_dir.find(pat_name + "/") == 0 ||
-                rel_dir.find("/" + pat_name) != std::string::npos) {
-                ignored = true;
-            }
-        }
-        if (!pat.is_dir && !pat.has_glob) {
-            if (rel_dir == pat.raw || rel_dir.find("/" + pat.raw) != std::string::npos) {
-                ignored = true;
-            }
-        }
-    }
-    return ignored;
+    auto slash = rel_dir.rfind('/');
+    auto scope = scope_for(slash == std::string::npos ? "" : rel_dir.substr(0, slash));
+    return decide(scope.get(), rel_dir, true);
 }
 
 fs::path GitignoreParser::get_relative_path(const fs::path& full_path) const {
@@ -156,115 +156,252 @@ fs::path GitignoreParser::get_relative_path(const fs::path& full_path) const {
     return fs::relative(full_path, project_dir_);
 }
 
+// ── Parallel walk ─────────────────────────────────────────
+// Each worker owns a deque of directories still to read. It pushes and
+// pops subdirectories at the back (depth first, cache friendly); an idle
+// worker steals from the front of another's deque, which holds the
+// shallowest, usually largest, subtrees.
+//
+// A directory's own ignore file is read when the walk enters it, before
+// its entries are classified, and ignored subdirectories are never read.
+
 std::vector<fs::path> GitignoreParser::collect_files() const {
     std::vector<fs::path> files;
     if (!fs::exists(project_dir_)) return files;
 
-    std::vector<fs::path> dirs_to_visit;
-    dirs_to_visit.push_back(project_dir_);
+    struct DirTask {
+        fs::path dir;
+        std::string rel;   // relative to the project root, '/'-separated
+        std::shared_ptr<const Scope> scope;
+    };
+    struct WalkQueue {
+        std::mutex mu;
+        std::deque<DirTask> q;
+    };
+
+    size_t workers = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 16);
+    std::vector<WalkQueue> queues(workers);
+    std::vector<std::vector<fs::path>> found(workers);
+    std::atomic<size_t> pending{1};   // directories queued or being read
+    std::mutex err_mu;
+    std::exception_ptr err;
+    queues[0].q.push_back({project_dir_, "", root_});
 
-    while (!dirs_to_visit.empty()) {
-        fs::path dir = std::move(dirs_to_visit.back());
-        dirs_to_visit.pop_back();
+    auto take = [&](size_t self, DirTask& out) {
+        for (size_t k = 0; k < workers; k++) {
+            auto& wq = queues[(self + k) % workers];
+            std::lock_guard<std::mutex> lock(wq.mu);
+            if (wq.q.empty()) continue;
+            if (k == 0) {
+                out = std::move(wq.q.back());
+                wq.q.pop_back();
+            } else {
+                out = std::move(wq.q.front());
+                wq.q.pop_front();
+            }
+            return true;
+        }
+        return false;
+    };
 
-        for (const auto& entry : fs::directory_iterator(dir)) {
-            if (entry.is_directory()) {
-                std::string rel = fs::relative(entry.path(), project_dir_).string();
-                std::replace(rel.begin(), rel.end(), '\\', '/');
-                if (!is_dir_ignored(rel)) {
-                    dirs_to_visit.push_back(entry.path());
+    auto work = [&](size_t self) {
+        DirTask task;
+        int idle = 0;
+        while (pending.load() > 0) {
+            if (!take(self, task)) {
+                if (++idle < 64) std::this_thread::yield();
+                else std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            idle = 0;
+            try {
+                std::vector<fs::directory_entry> entries;
+                bool has_ignore_file = false;
+                for (const auto& entry : fs::directory_iterator(task.dir)) {
+                    auto name = entry.path().filename();
+                    if (name == ".tccpignore" || name == ".gitignore") has_ignore_file = true;
+                    entries.push_back(entry);
                 }
-            } else if (entry.is_regular_file()) {
-                if (!is_ignored(entry.path())) {
-                    files.push_back(entry.path());
+                auto scope = has_ignore_file && !task.rel.empty()
+                    ? enter(task.scope, task.dir, task.rel) : task.scope;
+
+                for (const auto& entry : entries) {
+                    std::string name = entry.path().filename().string();
+                    std::string rel = task.rel.empty() ? name : task.rel + "/" + name;
+                    if (entry.is_directory()) {
+                        if (!decide(scope.get(), rel, true)) {
+                            pending++;
+                            std::lock_guard<std::mutex> lock(queues[self].mu);
+                            queues[self].q.push_back({entry.path(), std::move(rel), scope});
+                        }
+                    } else if (entry.is_regular_file()) {
+                        if (!decide(scope.get(), rel, false)) {
+                            found[self].push_back(entry.path());
+                        }
+                    }
                 }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(err_mu);
+                if (!err) err = std::current_exception();
             }
+            pending--;
         }
-    }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; i++) pool.emplace_back(work, i);
+    work(0);
+    for (auto& t : pool) t.join();
+    if (err) std::rethrow_exception(err);
 
+    size_t total = 0;
+    for (const auto& f : found) total += f.size();
+    files.reserve(total);
+    for (auto& f : found) {
+        std::move(f.begin(), f.end(), std::back_inserter(files));
+    }
     std::sort(files.begin(), files.end());
     return files;
 }
 
-bool GitignoreParser::matches_pattern(const std::string& path, const Pattern& pat) const {
-    if (pat.has_glob) {
-        return std::regex_search(path, pat.compiled);
-    }
+// ── Sync ──────────────────────────────────────────────────
 
-    const std::string& pattern = pat.raw;
-    if (pattern == "*") return true;
+Sync::Sync(SSH& ssh, const Config& cfg) : ssh_(ssh), cfg_(cfg) {
+    ssh_.set_compression(cfg_.project.compression);
+    ssh_.set_streams(cfg_.project.streams);
+}
 
-    if (pat.is_dir) {
-        std::string pattern_without_slash = pattern.substr(0, pattern.length() - 1);
-        return path == pattern_without_slash || path.find(pattern_without_slash + "/") == 0;
-    }
+Sync::~Sync() {
+    if (filling_.valid()) filling_.wait();
+}
 
-    return path == pattern || path.find("/" + pattern) != std::string::npos;
+// Hash entries[i] for every i in todo, spread across cores.
+static void hash_entries(const fs::path& root, std::vector<ManifestEntry>& entries,
+                         const std::vector<size_t>& todo) {
+    if (todo.empty()) return;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t workers = std::min(todo.size(), cores);
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t k; (k = next++) < todo.size();) {
+            auto& e = entries[todo[k]];
+            auto h = hash_file(root / e.path);
+            e.hash = h.is_ok() ? h.value : 0;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; i++) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
 }
 
-std::string GitignoreParser::glob_to_regex(const std::string& glob) {
-    std::string regex;
-    bool escape = false;
+// Manifest entry (without hash) for a file in the tree.
+static ManifestEntry stat_entry(const fs::path& file, std::string rel) {
+    auto ftime = fs::last_write_time(file);
+    auto time_since_epoch = ftime.time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time_since_epoch).count();
 
-    for (size_t i = 0; i < glob.length(); ++i) {
-        char c = glob[i];
-        if (escape) {
-            regex += c;
-            escape = false;
-        } else if (c == '\\') {
-            escape = true;
-        } else if (c == '*') {
-            if (i + 1 < glob.length() && glob[i + 1] == '*') {
-                regex += ".*";
-                i++;
-            } else {
-                regex += "[^/]*";
-            }
-        } else if (c == '?') {
-            regex += "[^/]";
-        } else if (c == '.') {
-            regex += "\\.";
-        } else if (c == '[') {
-            regex += '[';
-        } else if (c == ']') {
-            regex += ']';
-        } else {
-            regex += c;
-        }
-    }
-    return regex;
+    ManifestEntry entry;
+    entry.path = std::move(rel);
+    entry.mtime = static_cast<int64_t>(seconds);
+    entry.size = static_cast<int64_t>(fs::file_size(file));
+    return entry;
 }
 
-// ── Sync ──────────────────────────────────────────────────
+// Unix seconds, as the node's tar and stat see them (a manifest's mtime
+// counts from the file clock's epoch, which is a whole number of seconds
+// away on every implementation we build with).
+static int64_t unix_mtime(const fs::path& file) {
+    using namespace std::chrono;
+    std::error_code ec;
+    auto t = fs::last_write_time(file, ec);
+    if (ec) return 0;
+    auto offset = round<seconds>(fs::file_time_type::clock::now().time_since_epoch() -
+                                 system_clock::now().time_since_epoch());
+    return floor<seconds>(t.time_since_epoch() - offset).count();
+}
 
-Sync::Sync(SSH& ssh, const Config& cfg) : ssh_(ssh), cfg_(cfg) {}
+// Whether path lies below one of dirs
+static bool under_any(const std::string& path, const std::vector<std::string>& dirs) {
+    for (const auto& d : dirs) {
+        if (path.size() > d.size() && path[d.size()] == '/' && path.compare(0, d.size(), d) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-std::vector<ManifestEntry> Sync::build_manifest() {
+std::vector<ManifestEntry> Sync::build_manifest(const std::vector<ManifestEntry>& prev) {
     GitignoreParser parser(cfg_.project_dir, cfg_.project.rodata);
     auto files = parser.collect_files();
 
+    std::map<std::string, const ManifestEntry*> prev_map;
+    for (const auto& e : prev) {
+        prev_map[e.path] = &e;
+    }
+
     std::vector<ManifestEntry> manifest;
     manifest.reserve(files.size());
+    std::vector<size_t> to_hash;
 
     for (const auto& file : files) {
-        auto rel = parser.get_relative_path(file);
-        auto ftime = fs::last_write_time(file);
-        auto time_since_epoch = ftime.time_since_epoch();
-        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time_since_epoch).count();
-
-        ManifestEntry entry;
-        entry.path = rel.string();
-        entry.mtime = static_cast<int64_t>(seconds);
-        entry.size = static_cast<int64_t>(fs::file_size(file));
+        // Walked paths are project_dir / rel, so no filesystem lookups needed
+        auto entry = stat_entry(file, file.lexically_relative(cfg_.project_dir).string());
+
+        // Unchanged stat data: trust the previous hash
+        auto it = prev_map.find(entry.path);
+        if (it != prev_map.end() && it->second->hash != 0 &&
+            it->second->mtime == entry.mtime && it->second->size == entry.size) {
+            entry.hash = it->second->hash;
+        } else {
+            to_hash.push_back(manifest.size());
+        }
         manifest.push_back(std::move(entry));
     }
+
+    hash_entries(cfg_.project_dir, manifest, to_hash);
     return manifest;
 }
 
+Sync::DeltaReport Sync::push_deltas(const std::string& node, const std::string& scratch,
+                                   const std::vector<ManifestEntry>& prev) {
+    DeltaReport report;
+    auto& agent = ssh_.agent(Target::compute(node));
+    for (const auto& e : prev) {
+        std::string remote = scratch + "/" + e.path;
+        uint32_t bs = delta_block_size(e.size);
+        auto sig = agent.signature(remote, bs);
+        if (sig.is_err()) {
+            debug_log("delta", fmt::format("{}: no signature: {}", e.path, sig.error));
+            report.failed.push_back(e.path);
+            continue;
+        }
+        // Past half the file (or 256 MB) of new data, a whole send is as cheap
+        uint64_t max_literal = std::min<uint64_t>(static_cast<uint64_t>(e.size) / 2, 256ull << 20);
+        auto delta = make_delta(cfg_.project_dir / e.path, sig.value, max_literal);
+        if (delta.is_err()) {
+            debug_log("delta", fmt::format("{}: {}", e.path, delta.error));
+            report.failed.push_back(e.path);
+            continue;
+        }
+        auto applied = agent.apply_delta(remote, bs, delta.value);
+        if (applied.is_err()) {
+            debug_log("delta", fmt::format("{}: apply failed: {}", e.path, applied.error));
+            report.failed.push_back(e.path);
+            continue;
+        }
+        report.files++;
+        report.raw_bytes += static_cast<uint64_t>(delta.value.size);
+        report.wire_bytes += sig.value.blocks.size() * (4 + 16) + delta.value.ops.size();
+    }
+    return report;
+}
+
 void Sync::diff_manifests(const std::vector<ManifestEntry>& cur,
                           const std::vector<ManifestEntry>& prev,
                           std::vector<std::string>& changed,
-                          std::vector<std::string>& deleted) {
+                          std::vector<std::string>& deleted,
+                          size_t& touched) {
     // Build lookup from previous manifest
     std::map<std::string, const ManifestEntry*> prev_map;
     for (const auto& e : prev) {
@@ -278,8 +415,14 @@ void Sync::diff_manifests(const std::vector<ManifestEntry>& cur,
         auto it = prev_map.find(e.path);
         if (it == prev_map.end()) {
             changed.push_back(e.path);  // new file
-        } else if (it->second->mtime != e.mtime || it->second->size != e.size) {
+        } else if (it->second->size != e.size) {
             changed.push_back(e.path);  // modified
+        } else if (it->second->mtime != e.mtime) {
+            if (e.hash != 0 && it->second->hash == e.hash) {
+                touched++;              // rewritten with identical bytes
+            } else {
+                changed.push_back(e.path);
+            }
         }
     }
 
@@ -293,18 +436,28 @@ void Sync::diff_manifests(const std::vector<ManifestEntry>& cur,
 
 Result<void> Sync::push(const std::string& node, const std::string& scratch,
                         SessionState& state, StatusCallback cb) {
-    auto manifest = build_manifest();
+    // A scan made by scan() only needs its stats rechecked
+    std::vector<ManifestEntry> scanned;
+    {
+        std::lock_guard<std::mutex> lock(staged_mu_);
+        scanned.swap(staged_);
+    }
+    bool staged = !scanned.empty();
+    auto manifest = build_manifest(staged ? scanned : state.manifest);
 
     std::vector<std::string> changed, deleted;
-    if (state.manifest.empty()) {
-        // First sync: push everything
-        for (const auto& e : manifest) {
-            changed.push_back(e.path);
-        }
-    } else {
-        diff_manifests(manifest, state.manifest, changed, deleted);
+    size_t touched = 0;
+    plan_push(manifest, state.manifest, changed, deleted, touched);
+
+    if (!cfg_.project.rodata.empty()) {
+        auto packed = push_rodata(node, scratch, manifest, changed, deleted, cb);
+        if (packed.is_err()) return packed;
     }
 
+    if (state.manifest.empty()) reconcile(node, scratch, manifest, changed, cb);
+    if (state.manifest.empty() || staged) hydrate(node, scratch, manifest, changed, cb);
+    if (touched && cb) cb(fmt::format("Skipping {} touched but unchanged", touched));
+
     if (changed.empty() && deleted.empty()) {
         if (cb) cb("No changes to sync");
         state.manifest = manifest;
@@ -313,26 +466,659 @@ Result<void> Sync::push(const std::string& node, const std::string& scratch,
 
     if (cb) cb(fmt::format("Syncing {} changed, {} deleted", changed.size(), deleted.size()));
 
-    // Push changed files via tar
-    if (!changed.empty()) {
-        auto result = ssh_.tar_push(node, cfg_.project_dir, changed, scratch);
-        if (result.is_err()) return result;
+    // Large files the node already has a copy of go as deltas
+    std::map<std::string, int64_t> cur_size;
+    for (const auto& e : manifest) cur_size[e.path] = e.size;
+    std::set<std::string> changed_set(changed.begin(), changed.end());
+    std::vector<ManifestEntry> delta_basis;
+    for (const auto& e : state.manifest) {
+        if (e.size >= DELTA_MIN_BYTES && changed_set.count(e.path) &&
+            cur_size[e.path] >= DELTA_MIN_BYTES) {
+            delta_basis.push_back(e);
+        }
     }
 
-    // Remove deleted files on remote
-    if (!deleted.empty()) {
-        std::string rm_cmd;
-        for (const auto& d : deleted) {
-            rm_cmd += fmt::format("rm -f {}/{} ; ", scratch, d);
-        }
-        ssh_.run_compute(node, rm_cmd);
+    // Record progress as it lands, so a failed push can pick up from there
+    PushJournal journal(cfg_.project_name, node, scratch);
+    PushProgress progress;
+    resume_push(node, scratch, manifest, changed, progress, cb);
+    std::map<std::string, uint64_t> hash_of;
+    for (const auto& e : manifest) hash_of[e.path] = e.hash;
+    auto hash = [&](const std::string& f) {
+        auto it = hash_of.find(f);  // workers share the map: no inserts
+        return it == hash_of.end() ? 0 : it->second;
+    };
+    progress.file_sent = [&](const std::string& f) { journal.file_sent(f, hash(f)); };
+    progress.chunk_sent = [&](const std::string& f, uint64_t off) {
+        journal.chunk_sent(f, hash(f), off);
+    };
+
+    auto result = send_changes(node, scratch, changed, deleted, delta_basis, cb, &progress);
+    if (result.is_err()) return result;
+    journal.clear();
+
+    std::vector<const ManifestEntry*> sent;
+    for (const auto& e : manifest) {
+        if (changed_set.count(e.path)) sent.push_back(&e);
     }
+    fill_cache(node, scratch, sent);
 
     state.manifest = manifest;
     if (cb) cb(fmt::format("Synced {} files", changed.size()));
     return Result<void>::Ok();
 }
 
+void Sync::plan_push(const std::vector<ManifestEntry>& manifest,
+                     const std::vector<ManifestEntry>& prev,
+                     std::vector<std::string>& changed, std::vector<std::string>& deleted,
+                     size_t& touched) {
+    if (prev.empty()) {
+        // First sync: push everything
+        for (const auto& e : manifest) {
+            changed.push_back(e.path);
+        }
+    } else {
+        diff_manifests(manifest, prev, changed, deleted, touched);
+    }
+
+    // rodata travels as images, not file by file
+    auto ro_dirs = rodata_dirs(cfg_.project);
+    if (!ro_dirs.empty()) {
+        auto in_rodata = [&](const std::string& f) { return under_any(f, ro_dirs); };
+        changed.erase(std::remove_if(changed.begin(), changed.end(), in_rodata), changed.end());
+        deleted.erase(std::remove_if(deleted.begin(), deleted.end(), in_rodata), deleted.end());
+    }
+}
+
+void Sync::resume_push(const std::string& node, const std::string& scratch,
+                       const std::vector<ManifestEntry>& manifest,
+                       std::vector<std::string>& changed, PushProgress& progress,
+                       StatusCallback cb) {
+    PushJournal journal(cfg_.project_name, node, scratch);
+    auto entries = journal.load();
+    if (entries.empty()) return;
+
+    std::map<std::string, const ManifestEntry*> cur;
+    for (const auto& e : manifest) cur[e.path] = &e;
+    std::set<std::string> changed_set(changed.begin(), changed.end());
+
+    // Only pieces of the files as they are now count
+    std::vector<const PushJournal::Entry*> pieces;
+    std::vector<RemoteRange> ranges;
+    std::set<std::pair<std::string, uint64_t>> seen;
+    for (const auto& j : entries) {
+        auto it = cur.find(j.path);
+        if (it == cur.end() || it->second->hash != j.hash || !changed_set.count(j.path)) continue;
+        if (!seen.insert({j.path, j.chunk ? j.offset : UINT64_MAX}).second) continue;
+        auto size = static_cast<uint64_t>(it->second->size);
+        RemoteRange r;
+        if (j.chunk) {
+            if (size < PUSH_SPLIT_BYTES || j.offset >= size || j.offset % PUSH_CHUNK_BYTES) continue;
+            r.path = scratch + "/" + j.path + PUSH_PART_SUFFIX;
+            r.offset = static_cast<int64_t>(j.offset);
+            r.len = static_cast<int64_t>(std::min(PUSH_CHUNK_BYTES, size - j.offset));
+        } else {
+            r.path = scratch + "/" + j.path;
+            r.len = static_cast<int64_t>(size);
+        }
+        pieces.push_back(&j);
+        ranges.push_back(std::move(r));
+    }
+    if (ranges.empty()) {
+        journal.clear();
+        return;
+    }
+
+    // Ask the node what it still has: each file or chunk by MD5
+    auto sums = ssh_.agent(Target::compute(node)).range_sums(ranges);
+    if (sums.is_err()) {
+        debug_log("sync", fmt::format("can't resume: {}", sums.error));
+        journal.clear();
+        return;
+    }
+    std::set<std::string> done;
+    size_t chunks = 0;
+    uint64_t bytes = 0;
+    std::vector<char> buf(1 << 20);
+    for (size_t i = 0; i < pieces.size(); i++) {
+        const auto& j = *pieces[i];
+        const auto& got = sums.value[i];
+        if (!j.chunk && got.size != cur[j.path]->size) continue;
+        if (ranges[i].len == 0) {
+            done.insert(j.path);  // empty: the size says it all
+            continue;
+        }
+        std::ifstream in(cfg_.project_dir / j.path, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(j.offset));
+        MD5 local;
+        int64_t left = ranges[i].len;
+        while (left > 0 && in.read(buf.data(), std::min<int64_t>(left, buf.size()))) {
+            local.update(buf.data(), static_cast<size_t>(in.gcount()));
+            left -= in.gcount();
+        }
+        if (left != 0 || local.digest() != got.md5) continue;
+        if (j.chunk) {
+            progress.have[j.path].insert(j.offset);
+            chunks++;
+        } else {
+            done.insert(j.path);
+        }
+        bytes += static_cast<uint64_t>(ranges[i].len);
+    }
+    if (done.empty() && chunks == 0) {
+        journal.clear();
+        return;
+    }
+
+    changed.erase(std::remove_if(changed.begin(), changed.end(),
+                                 [&](const std::string& f) { return done.count(f) > 0; }),
+                  changed.end());
+    if (cb) {
+        cb(fmt::format("Resuming: {} files and {} chunks ({:.1f} MB) already on the node",
+                       done.size(), chunks, bytes / 1048576.0));
+    }
+}
+
+// ── rodata images ─────────────────────────────────────────
+// Each rodata directory is packed into a squashfs image on NFS, keyed by
+// an XXH64 over its files' paths, sizes and content hashes (stored next
+// to it as <image>.hash). The image is rebuilt only when that changes:
+// the files go to the node as one tar stream, are unpacked into a
+// temporary directory on its /tmp and packed by mksquashfs. Millions of
+// small files then cost one sequential file on every later node, instead
+// of a file create each. Where mksquashfs can't be found, the directory
+// is pushed file by file like the rest of the project.
+
+static const char* SQUASHFS_INIT =
+    "type module &>/dev/null || . /etc/profile 2>/dev/null || true; "
+    "module load squashfs-tools 2>/dev/null || module load squashfs 2>/dev/null || true; "
+    "export PATH=~/.tccp/bin:$PATH:/usr/sbin:/sbin";
+
+std::vector<std::string> rodata_dirs(const ProjectConfig& project) {
+    std::vector<std::string> dirs;
+    for (auto d : project.rodata) {
+        while (d.compare(0, 2, "./") == 0) d.erase(0, 2);
+        while (!d.empty() && d.back() == '/') d.pop_back();
+        if (d.empty() || d == "." || d[0] == '/') continue;
+        if (std::find(dirs.begin(), dirs.end(), d) == dirs.end()) dirs.push_back(d);
+    }
+    return dirs;
+}
+
+std::string rodata_image(const std::string& project_name, const std::string& dir) {
+    std::string slug = dir;
+    std::replace(slug.begin(), slug.end(), '/', '_');
+    return fmt::format("~/.tccp/projects/{}/rodata/{}.sqfs", project_name, slug);
+}
+
+Result<void> Sync::push_rodata(const std::string& node, const std::string& scratch,
+                               const std::vector<ManifestEntry>& manifest,
+                               std::vector<std::string>& changed, std::vector<std::string>& deleted,
+                               StatusCallback cb) {
+    struct Image {
+        std::string dir;
+        std::string hash;
+        std::vector<std::string> files;   // relative to dir
+        uint64_t bytes = 0;
+    };
+    std::vector<Image> images;
+    for (const auto& dir : rodata_dirs(cfg_.project)) {
+        std::error_code ec;
+        if (!fs::is_directory(cfg_.project_dir / dir, ec)) continue;
+        Image img;
+        img.dir = dir;
+        XXH64 h;
+        std::string prefix = dir + "/";
+        for (const auto& e : manifest) {
+            if (e.path.compare(0, prefix.size(), prefix) != 0) continue;
+            std::string rel = e.path.substr(prefix.size());
+            std::string rec = fmt::format("{}\n{}\n{:016x}\n", rel, e.size, e.hash);
+            h.update(rec.data(), rec.size());
+            img.bytes += static_cast<uint64_t>(e.size);
+            img.files.push_back(std::move(rel));
+        }
+        img.hash = fmt::format("{:016x}", h.digest());
+        images.push_back(std::move(img));
+    }
+    if (images.empty()) return Result<void>::Ok();
+
+    // One round trip: what each image holds now, whether mksquashfs is
+    // there to rebuild them, and the mount points
+    std::vector<std::string> cmds;
+    std::string mount_points;
+    for (const auto& img : images) {
+        cmds.push_back(fmt::format("cat {0}.hash 2>/dev/null || {{ test -f {0} && echo stale; }}",
+                                   rodata_image(cfg_.project_name, img.dir)));
+        mount_points += " " + scratch + "/" + img.dir;
+    }
+    cmds.push_back(fmt::format("{}; command -v mksquashfs", SQUASHFS_INIT));
+    cmds.push_back("mkdir -p" + mount_points);
+    auto probe = ssh_.run_batch(Target::compute(node), cmds);
+    if (!probe.back().ok()) {
+        return Result<void>::Err(fmt::format("Can't create rodata mount points: {}",
+                                             trim(probe.back().err)));
+    }
+
+    bool can_pack = probe[images.size()].ok();
+    std::vector<const Image*> loose;
+    std::string build_dir = (fs::path(scratch).parent_path() / ".tccp-rodata.$$").string();
+    for (size_t i = 0; i < images.size(); i++) {
+        const auto& img = images[i];
+        if (trim(probe[i].out) == img.hash) continue;
+        if (!can_pack) {
+            loose.push_back(&img);
+            continue;
+        }
+        if (cb) {
+            cb(fmt::format("Packing rodata {} ({} files, {:.1f} MB)...", img.dir,
+                           img.files.size(), img.bytes / 1048576.0));
+        }
+        std::string image = rodata_image(cfg_.project_name, img.dir);
+        std::string cmd = fmt::format(
+            "{init}; T={tmp}; rm -rf $T {img}.hash && mkdir -p $T $(dirname {img}) && "
+            "tar xf - -C $T && mksquashfs $T {img}.tmp -noappend -no-progress >/dev/null && "
+            "mv -f {img}.tmp {img} && echo {hash} > {img}.hash; "
+            "rc=$?; rm -rf $T {img}.tmp; exit $rc",
+            fmt::arg("init", SQUASHFS_INIT), fmt::arg("tmp", build_dir),
+            fmt::arg("img", image), fmt::arg("hash", img.hash));
+        auto r = ssh_.tar_to_command(Target::compute(node), cfg_.project_dir / img.dir, img.files, cmd);
+        if (r.is_err()) {
+            return Result<void>::Err(fmt::format("Packing rodata {} failed: {}", img.dir, r.error));
+        }
+        debug_log("sync", fmt::format("rodata {} → {} ({})", img.dir, image, img.hash));
+    }
+    if (loose.empty()) return Result<void>::Ok();
+
+    // No mksquashfs: drop the images, so nothing is mounted over the
+    // directories, and send what the node's copy of them lacks
+    auto& agent = ssh_.agent(Target::compute(node));
+    std::string drop = "rm -f";
+    for (const auto* img : loose) {
+        std::string image = rodata_image(cfg_.project_name, img->dir);
+        debug_log("sync", fmt::format("mksquashfs not found; pushing rodata {} file by file", img->dir));
+        drop += fmt::format(" {0} {0}.hash", image);
+
+        std::map<std::string, const ManifestEntry*> there;
+        auto remote = agent.manifest(scratch + "/" + img->dir);
+        if (remote.is_ok()) {
+            for (const auto& e : remote.value) there[e.path] = &e;
+        }
+        std::string prefix = img->dir + "/";
+        for (const auto& e : manifest) {
+            if (e.path.compare(0, prefix.size(), prefix) != 0) continue;
+            auto it = there.find(e.path.substr(prefix.size()));
+            bool same = it != there.end() && it->second->size == e.size &&
+                        it->second->mtime == unix_mtime(cfg_.project_dir / e.path);
+            if (it != there.end()) there.erase(it);
+            if (!same) changed.push_back(e.path);
+        }
+        for (const auto& [rel, e] : there) deleted.push_back(prefix + rel);
+    }
+    auto r = ssh_.run_compute(node, drop);
+    if (!r.ok()) {
+        return Result<void>::Err(fmt::format("Can't remove rodata images: {}", trim(r.err)));
+    }
+    return Result<void>::Ok();
+}
+
+void Sync::reconcile(const std::string& node, const std::string& scratch,
+                     const std::vector<ManifestEntry>& manifest,
+                     std::vector<std::string>& changed, StatusCallback cb) {
+    if (changed.empty()) return;
+    auto remote = ssh_.agent(Target::compute(node)).manifest(scratch);
+    if (remote.is_err()) {
+        debug_log("sync", fmt::format("can't list scratch: {}", remote.error));
+        return;
+    }
+    if (remote.value.empty()) return;
+
+    // Tar keeps mtimes, so a file the node got from us has ours, to the second
+    std::map<std::string, const ManifestEntry*> there;
+    for (const auto& e : remote.value) there[e.path] = &e;
+    std::set<std::string> changed_set(changed.begin(), changed.end());
+    std::set<std::string> same;
+    uint64_t bytes = 0;
+    for (const auto& e : manifest) {
+        auto it = there.find(e.path);
+        if (it == there.end() || it->second->size != e.size || !changed_set.count(e.path)) continue;
+        std::error_code ec;
+        fs::path file = cfg_.project_dir / e.path;
+        if (!fs::is_regular_file(fs::symlink_status(file, ec)) ||
+            it->second->mtime != unix_mtime(file)) {
+            continue;
+        }
+        same.insert(e.path);
+        bytes += static_cast<uint64_t>(e.size);
+    }
+    if (same.empty()) return;
+
+    changed.erase(std::remove_if(changed.begin(), changed.end(),
+                                 [&](const std::string& f) { return same.count(f) > 0; }),
+                  changed.end());
+    if (cb) {
+        cb(fmt::format("Reusing {} files ({:.1f} MB) already in scratch",
+                       same.size(), bytes / 1048576.0));
+    }
+}
+
+// ── Object cache ──────────────────────────────────────────
+// ~/.tccp/cas on the cluster's NFS holds one copy of every file pushed,
+// named by content (XXH64 and size). A new scratch, on a node that has
+// never seen the project, is filled from it by the node itself, so only
+// files the cluster has never had cross the WAN. Shared by all projects.
+
+static constexpr const char* CAS_ROOT = "~/.tccp/cas";
+static constexpr int CAS_KEEP_DAYS = 30;
+// Smaller files are cheaper to send again than to copy through NFS
+static constexpr int64_t CAS_MIN_BYTES = 256 << 10;
+
+static std::string cas_key(const ManifestEntry& e) {
+    return fmt::format("{:016x}-{}", e.hash, e.size);
+}
+
+// Only hashed regular files of CAS_MIN_BYTES or more go through the
+// cache; symlinks travel in the tar.
+static bool cacheable(const ManifestEntry& e, const fs::path& file, fs::file_status& st) {
+    if (e.hash == 0 || e.size < CAS_MIN_BYTES) return false;
+    std::error_code ec;
+    st = fs::symlink_status(file, ec);
+    return !ec && fs::is_regular_file(st);
+}
+
+void Sync::hydrate(const std::string& node, const std::string& scratch,
+                   const std::vector<ManifestEntry>& manifest,
+                   std::vector<std::string>& changed, StatusCallback cb) {
+    if (!cfg_.global.file_cache || changed.empty()) return;
+    std::set<std::string> changed_set(changed.begin(), changed.end());
+    std::vector<CasObject> objects;
+    std::vector<int64_t> sizes;
+    for (const auto& e : manifest) {
+        if (!changed_set.count(e.path)) continue;
+        fs::path file = cfg_.project_dir / e.path;
+        fs::file_status st;
+        if (!cacheable(e, file, st)) continue;
+        CasObject o;
+        o.key = cas_key(e);
+        o.path = e.path;
+        o.mode = static_cast<uint32_t>(st.permissions()) & 0777;
+        o.mtime = unix_mtime(file);
+        objects.push_back(std::move(o));
+        sizes.push_back(e.size);
+    }
+    if (objects.empty()) return;
+
+    auto got = ssh_.agent(Target::compute(node)).cas_get(CAS_ROOT, scratch, objects, CAS_KEEP_DAYS);
+    if (got.is_err()) {
+        debug_log("sync", fmt::format("object cache unavailable: {}", got.error));
+        return;
+    }
+    if (got.value.empty()) return;
+    std::set<std::string> done;
+    uint64_t bytes = 0;
+    for (size_t i : got.value) {
+        done.insert(objects[i].path);
+        bytes += static_cast<uint64_t>(sizes[i]);
+    }
+    changed.erase(std::remove_if(changed.begin(), changed.end(),
+                                 [&](const std::string& f) { return done.count(f) > 0; }),
+                  changed.end());
+    if (cb) {
+        cb(fmt::format("Hydrated {} files ({:.1f} MB) from the cluster cache",
+                       done.size(), bytes / 1048576.0));
+    }
+}
+
+void Sync::scan(const SessionState& state) {
+    auto manifest = build_manifest(state.manifest);
+    std::lock_guard<std::mutex> lock(staged_mu_);
+    staged_ = std::move(manifest);
+}
+
+void Sync::stage(const SessionState& state, const std::atomic<bool>& stop, StatusCallback cb) {
+    if (!cfg_.global.file_cache || stop) return;
+
+    // What the next push will send, once per content. Once push has taken
+    // the scan there is nothing left to stage.
+    std::vector<ManifestEntry> wanted;
+    std::vector<RemoteRange> ranges;
+    {
+        std::lock_guard<std::mutex> lock(staged_mu_);
+        if (staged_.empty()) return;
+        std::vector<std::string> changed, deleted;
+        size_t touched = 0;
+        plan_push(staged_, state.manifest, changed, deleted, touched);
+        std::set<std::string> changed_set(changed.begin(), changed.end());
+        std::set<std::string> keys;
+        for (const auto& e : staged_) {
+            fs::file_status st;
+            if (!changed_set.count(e.path) || !cacheable(e, cfg_.project_dir / e.path, st)) {
+                continue;
+            }
+            std::string key = cas_key(e);
+            if (!keys.insert(key).second) continue;
+            RemoteRange r;
+            r.path = fmt::format("{}/{}/{}", CAS_ROOT, key.substr(0, 2), key);
+            ranges.push_back(std::move(r));
+            wanted.push_back(e);
+        }
+    }
+    if (wanted.empty()) return;
+
+    // The cache's copies, by size
+    auto& agent = ssh_.agent(Target::dtn());
+    auto sums = agent.range_sums(ranges);
+    if (sums.is_err()) {
+        debug_log("sync", fmt::format("can't stage: {}", sums.error));
+        return;
+    }
+    std::vector<std::string> files, names;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < wanted.size(); i++) {
+        if (sums.value[i].size == wanted[i].size) continue;
+        std::string key = cas_key(wanted[i]);
+        files.push_back(wanted[i].path);
+        names.push_back(key.substr(0, 2) + "/" + key);
+        bytes += static_cast<uint64_t>(wanted[i].size);
+    }
+    if (files.empty() || stop) return;
+
+    // Unpacked aside, then renamed in: a cut stream leaves no partial objects.
+    // Stopping ends the archive cleanly, so what was sent is kept.
+    // Fresh mtimes (x -m) count as use for pruning.
+    if (cb) {
+        cb(fmt::format("Staging {} files ({:.1f} MB) to the cluster cache...",
+                       files.size(), bytes / 1048576.0));
+    }
+    std::string cmd = fmt::format(
+        "D={0}/.in.$$; rm -rf $D && mkdir -p $D && tar xmf - -C $D && (cd $D && "
+        "for d in */; do [ -d \"$d\" ] || continue; mkdir -p ../$d && "
+        "find $d -type f -exec mv -f -t ../$d {{}} + || exit 1; done); "
+        "rc=$?; rm -rf $D; exit $rc",
+        CAS_ROOT);
+    auto r = ssh_.tar_to_command(Target::dtn(), cfg_.project_dir, files, cmd, names, &stop);
+    if (r.is_err()) debug_log("sync", fmt::format("staging failed: {}", r.error));
+}
+
+void Sync::fill_cache(const std::string& node, const std::string& scratch,
+                      const std::vector<const ManifestEntry*>& files) {
+    if (!cfg_.global.file_cache) return;
+    std::vector<ManifestEntry> wanted;
+    for (const auto* e : files) {
+        fs::file_status st;
+        if (cacheable(*e, cfg_.project_dir / e->path, st)) wanted.push_back(*e);
+    }
+    if (wanted.empty()) return;
+    // The last fill has usually finished during this push's transfer
+    if (filling_.valid()) filling_.wait();
+    filling_ = std::async(std::launch::async, [this, node, scratch, wanted = std::move(wanted)] {
+        std::vector<CasObject> objects;
+        std::vector<char> buf(1 << 20);
+        for (const auto& e : wanted) {
+            // The node's copy must be the content the key names: hash ours
+            // now, skipping files edited since the scan, and let the agent
+            // compare
+            std::ifstream in(cfg_.project_dir / e.path, std::ios::binary);
+            XXH64 xh;
+            MD5 mh;
+            int64_t size = 0;
+            while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) || in.gcount() > 0) {
+                auto n = static_cast<size_t>(in.gcount());
+                xh.update(buf.data(), n);
+                mh.update(buf.data(), n);
+                size += static_cast<int64_t>(n);
+            }
+            if (in.bad() || size != e.size || xh.digest() != e.hash) continue;
+            CasObject o;
+            o.key = cas_key(e);
+            o.path = e.path;
+            o.size = size;
+            o.md5 = mh.digest();
+            objects.push_back(std::move(o));
+        }
+        if (objects.empty()) return;
+        // Best effort: a file the cache misses is just sent again next time
+        auto put = ssh_.agent(Target::compute(node)).cas_put(CAS_ROOT, scratch, objects);
+        if (put.is_err()) {
+            debug_log("sync", fmt::format("object cache not filled: {}", put.error));
+        } else if (put.value.files) {
+            debug_log("sync", fmt::format("object cache: stored {} files, {} bytes",
+                                          put.value.files, put.value.bytes));
+        }
+    });
+}
+
+Result<void> Sync::send_changes(const std::string& node, const std::string& scratch,
+                                const std::vector<std::string>& changed,
+                                const std::vector<std::string>& deleted,
+                                const std::vector<ManifestEntry>& delta_basis,
+                                StatusCallback cb, PushProgress* progress) {
+    // Deltas go over the agent channel, next to the tar stream carrying
+    // everything else. They patch files in place, so atomic-sync sends
+    // everything in the staged stream instead.
+    const std::vector<ManifestEntry> no_deltas;
+    const auto& deltas = cfg_.project.atomic_sync ? no_deltas : delta_basis;
+    std::set<std::string> by_delta;
+    for (const auto& e : deltas) by_delta.insert(e.path);
+    std::vector<std::string> tar_files;
+    for (const auto& c : changed) {
+        if (!by_delta.count(c)) tar_files.push_back(c);
+    }
+
+    std::future<DeltaReport> delta_done;
+    if (!deltas.empty()) {
+        delta_done = std::async(std::launch::async, [&] {
+            return push_deltas(node, scratch, deltas);
+        });
+    }
+
+    // Changed files and deletions in one tar stream
+    auto result = ssh_.tar_push(node, cfg_.project_dir, tar_files, scratch, deleted,
+                                cfg_.project.atomic_sync, progress);
+    if (delta_done.valid()) {
+        auto report = delta_done.get();
+        if (report.files > 0 && cb) {
+            cb(fmt::format("Delta: {} large files, {:.1f} MB sent for {:.1f} MB",
+                           report.files, report.wire_bytes / 1048576.0,
+                           report.raw_bytes / 1048576.0));
+        }
+        if (result.is_ok() && !report.failed.empty()) {
+            result = ssh_.tar_push(node, cfg_.project_dir, report.failed, scratch);
+        }
+    }
+    return result;
+}
+
+Result<void> Sync::push_paths(const std::string& node, const std::string& scratch,
+                              std::map<std::string, ManifestEntry>& manifest,
+                              const std::set<std::string>& paths, StatusCallback cb) {
+    GitignoreParser parser(cfg_.project_dir, cfg_.project.rodata);
+
+    // A path may name a directory that went away: recheck what we had under it
+    std::set<std::string> check;
+    for (const auto& p : paths) {
+        check.insert(p);
+        std::string prefix = p + "/";
+        for (auto it = manifest.lower_bound(prefix);
+             it != manifest.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            check.insert(it->first);
+        }
+    }
+
+    std::vector<std::string> deleted;
+    std::vector<ManifestEntry> fresh;
+    std::vector<size_t> to_hash;
+    for (const auto& rel : check) {
+        fs::path file = cfg_.project_dir / rel;
+        std::error_code ec;
+        bool present = fs::is_regular_file(file, ec) && !parser.is_ignored(rel);
+        auto it = manifest.find(rel);
+        if (!present) {
+            if (it != manifest.end()) deleted.push_back(rel);
+            continue;
+        }
+        ManifestEntry e;
+        try {
+            e = stat_entry(file, rel);
+        } catch (const fs::filesystem_error&) {
+            continue;  // gone again; the next event will say so
+        }
+        if (it != manifest.end() && it->second.hash != 0 &&
+            it->second.mtime == e.mtime && it->second.size == e.size) {
+            continue;
+        }
+        to_hash.push_back(fresh.size());
+        fresh.push_back(std::move(e));
+    }
+    hash_entries(cfg_.project_dir, fresh, to_hash);
+
+    std::vector<std::string> changed;
+    std::vector<ManifestEntry> delta_basis;
+    for (const auto& e : fresh) {
+        auto it = manifest.find(e.path);
+        if (it == manifest.end()) {
+            changed.push_back(e.path);
+            continue;
+        }
+        const auto& old = it->second;
+        if (old.size == e.size && e.hash != 0 && old.hash == e.hash) continue;  // same bytes
+        changed.push_back(e.path);
+        if (old.size >= DELTA_MIN_BYTES && e.size >= DELTA_MIN_BYTES) delta_basis.push_back(old);
+    }
+
+    // rodata images are rebuilt by the next full push, not per event
+    auto ro_dirs = rodata_dirs(cfg_.project);
+    if (!ro_dirs.empty()) {
+        auto in_rodata = [&](const std::string& f) { return under_any(f, ro_dirs); };
+        changed.erase(std::remove_if(changed.begin(), changed.end(), in_rodata), changed.end());
+        deleted.erase(std::remove_if(deleted.begin(), deleted.end(), in_rodata), deleted.end());
+    }
+
+    // The manifest only takes the new state once the node has it
+    auto apply = [&] {
+        for (const auto& d : deleted) manifest.erase(d);
+        for (auto& e : fresh) manifest[e.path] = std::move(e);
+    };
+    if (changed.empty() && deleted.empty()) {
+        apply();
+        return Result<void>::Ok();
+    }
+    if (cb) cb(fmt::format("Syncing {} changed, {} deleted", changed.size(), deleted.size()));
+    auto result = send_changes(node, scratch, changed, deleted, delta_basis, cb);
+    if (result.is_err()) return result;
+    std::set<std::string> changed_set(changed.begin(), changed.end());
+    std::vector<const ManifestEntry*> sent;
+    for (const auto& e : fresh) {
+        if (changed_set.count(e.path)) sent.push_back(&e);
+    }
+    fill_cache(node, scratch, sent);
+    apply();
+    if (cb) {
+        if (changed.empty()) cb(fmt::format("Removed {} files", deleted.size()));
+        else cb(fmt::format("Synced {} files", changed.size()));
+    }
+    return Result<void>::Ok();
+}
+
 Result<void> Sync::pull_output(StatusCallback cb) {
     std::string output_dir = cfg_.project.output;
     // Strip trailing slash
@@ -341,19 +1127,44 @@ Result<void> Sync::pull_output(StatusCallback cb) {
 
     std::string nfs_output = fmt::format("~/.tccp/projects/{}/output", cfg_.project_name);
 
-    // Check if remote output dir has anything
-    auto check = ssh_.run(fmt::format("test -d {} && ls {} | head -1", nfs_output, nfs_output));
-    if (!check.ok() || check.out.empty()) {
+    // One listing of the remote output dir, diffed against the last pull
+    auto remote = ssh_.agent(Target::dtn()).manifest(nfs_output);
+    if (remote.is_err()) return Result<void>::Err(remote.error);
+    if (remote.value.empty()) {
         if (cb) cb("No output to pull");
         return Result<void>::Ok();
     }
 
-    if (cb) cb("Pulling output...");
+    StateStore store(cfg_.project_name);
+    std::map<std::string, ManifestEntry> pulled;
+    for (auto& e : store.load_pulled()) pulled[e.path] = std::move(e);
+
+    // Also fetch again whatever went missing locally since
     fs::path local_output = cfg_.project_dir / output_dir;
-    auto result = ssh_.tar_pull(nfs_output, local_output);
-    if (result.is_err()) return result;
+    std::vector<std::string> wanted;
+    uint64_t wanted_bytes = 0;
+    for (const auto& e : remote.value) {
+        auto it = pulled.find(e.path);
+        if (it != pulled.end() && it->second.size == e.size && it->second.mtime == e.mtime) {
+            std::error_code ec;
+            auto local_size = fs::file_size(local_output / e.path, ec);
+            if (!ec && static_cast<int64_t>(local_size) == e.size) continue;
+        }
+        wanted.push_back(e.path);
+        wanted_bytes += static_cast<uint64_t>(e.size);
+    }
 
-    if (cb) cb(fmt::format("Output pulled to {}/", output_dir));
+    if (wanted.empty()) {
+        if (cb) cb("Output up to date");
+    } else {
+        if (cb) cb(fmt::format("Pulling {} of {} output files ({:.1f} MB)...", wanted.size(),
+                               remote.value.size(), static_cast<double>(wanted_bytes) / (1 << 20)));
+        auto result = ssh_.tar_pull(nfs_output, local_output, wanted);
+        if (result.is_err()) return result;
+        if (cb) cb(fmt::format("Output pulled to {}/", output_dir));
+    }
+    // Files gone from the node drop out; local copies stay
+    store.save_pulled(remote.value);
     return Result<void>::Ok();
 }
 
@@ -2,11 +2,21 @@
 
 #include "types.hpp"
 #include "ssh.hpp"
+#include "ignore.hpp"
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
-#include <filesystem>
-#include <regex>
 
+// Ignore rules: built-in defaults plus the project's .tccpignore (or
+// .gitignore), and the same file in any subdirectory, scoped to that
+// subtree. A deeper file's match overrides a shallower one; rodata
+// force-includes override everything.
 class GitignoreParser {
 public:
     explicit GitignoreParser(const fs::path& project_dir,
@@ -19,44 +29,134 @@ public:
     fs::path get_relative_path(const fs::path& full_path) const;
 
 private:
-    fs::path project_dir_;
-
-    struct Pattern {
-        std::string raw;
-        bool is_negation;
-        bool is_dir;
-        bool has_glob;
-        std::regex compiled;
+    // The ignore file of one directory, and the scopes enclosing it.
+    struct Scope {
+        std::shared_ptr<const Scope> parent;
+        std::string base;          // directory relative to the project root, "" = root
+        IgnoreMatcher matcher;
     };
-    std::vector<Pattern> patterns_;
-    std::vector<std::string> force_includes_;
 
-    bool is_force_included(const std::string& rel_path) const;
+    fs::path project_dir_;
+    std::shared_ptr<const Scope> root_;
+    // Scopes for is_ignored() calls outside a walk, by directory
+    mutable std::mutex scopes_mu_;
+    mutable std::map<std::string, std::shared_ptr<const Scope>> scopes_;
+
+    // The rules that apply inside rel_dir, loading ignore files on the way.
+    std::shared_ptr<const Scope> scope_for(const std::string& rel_dir) const;
+    // parent, plus dir's own ignore file if it has one with any rules.
+    static std::shared_ptr<const Scope> enter(const std::shared_ptr<const Scope>& parent,
+                                              const fs::path& dir, const std::string& rel_dir);
+    bool decide(const Scope* scope, const std::string& rel, bool dir) const;
 
-    void load_gitignore();
-    void add_default_patterns();
-    void add_pattern(const std::string& raw, bool is_negation);
-    bool matches_pattern(const std::string& path, const Pattern& pat) const;
-    static std::string glob_to_regex(const std::string& glob);
+    static bool load_ignore_file(const fs::path& dir, IgnoreMatcher& m);
+    static void add_default_patterns(IgnoreMatcher& m);
 };
 
+// rodata directories (normalized, relative to the project) and the
+// squashfs image each is packed into on the cluster's NFS. Sync builds
+// the images; the container bind-mounts them over scratch/<dir>.
+std::vector<std::string> rodata_dirs(const ProjectConfig& project);
+std::string rodata_image(const std::string& project_name, const std::string& dir);
+
 class Sync {
 public:
     Sync(SSH& ssh, const Config& cfg);
+    ~Sync();  // waits for a cache fill still running
 
     Result<void> push(const std::string& node, const std::string& scratch,
                       SessionState& state, StatusCallback cb = {});
+    // The part of the first push that needs no node, for Session::start
+    // to run while the allocation is pending. scan() hashes the project
+    // (push must not start before it returns); stage() then uploads the
+    // files push would send that the cluster's object cache lacks,
+    // through the DTN, until stop is set. Files already uploaded stay in
+    // the cache; push reuses the scan, fills the scratch from the cache
+    // and sends the rest.
+    void scan(const SessionState& state);
+    void stage(const SessionState& state, const std::atomic<bool>& stop, StatusCallback cb = {});
     Result<void> pull_output(StatusCallback cb = {});
     Result<void> refresh(const std::string& node, const std::string& scratch,
                          SessionState& state, StatusCallback cb = {});
+    // Push only what changed among paths (relative to the project; a path
+    // may be a directory, covering what manifest has below it). manifest
+    // is kept up to date in place. Silent when nothing changed.
+    Result<void> push_paths(const std::string& node, const std::string& scratch,
+                            std::map<std::string, ManifestEntry>& manifest,
+                            const std::set<std::string>& paths, StatusCallback cb = {});
 
 private:
     SSH& ssh_;
     const Config& cfg_;
+    std::mutex staged_mu_;               // staged_ is read by stage() as push takes it
+    std::vector<ManifestEntry> staged_;  // scan()'s result, for the next push
+    std::future<void> filling_;          // fill_cache's work, one at a time
+
+    // What a push from prev to manifest sends and deletes (rodata aside).
+    void plan_push(const std::vector<ManifestEntry>& manifest,
+                   const std::vector<ManifestEntry>& prev,
+                   std::vector<std::string>& changed, std::vector<std::string>& deleted,
+                   size_t& touched);
+
+    // Remove deleted and send changed files; large ones in delta_basis
+    // (the node's current size) go as deltas.
+    Result<void> send_changes(const std::string& node, const std::string& scratch,
+                              const std::vector<std::string>& changed,
+                              const std::vector<std::string>& deleted,
+                              const std::vector<ManifestEntry>& delta_basis,
+                              StatusCallback cb, PushProgress* progress = nullptr);
+    // What the journal of an interrupted push says the node already has,
+    // as far as the node confirms it: whole files are dropped from
+    // changed, chunks go into progress.have.
+    void resume_push(const std::string& node, const std::string& scratch,
+                     const std::vector<ManifestEntry>& manifest,
+                     std::vector<std::string>& changed, PushProgress& progress,
+                     StatusCallback cb);
+
+    // Pack each rodata directory whose contents changed into its image
+    // (one tar stream, mksquashfs on the node), and make its mount point.
+    // Without mksquashfs, those directories' files that differ from the
+    // node's copy are added to changed and deleted instead.
+    Result<void> push_rodata(const std::string& node, const std::string& scratch,
+                             const std::vector<ManifestEntry>& manifest,
+                             std::vector<std::string>& changed, std::vector<std::string>& deleted,
+                             StatusCallback cb);
+    // No manifest (state was cleared), but the scratch may be one we
+    // filled before: files the node has with our size and mtime are
+    // dropped from changed.
+    void reconcile(const std::string& node, const std::string& scratch,
+                   const std::vector<ManifestEntry>& manifest,
+                   std::vector<std::string>& changed, StatusCallback cb);
+    // Cold scratch: copy what the cluster's object cache already holds
+    // into it and drop those files from changed.
+    void hydrate(const std::string& node, const std::string& scratch,
+                 const std::vector<ManifestEntry>& manifest,
+                 std::vector<std::string>& changed, StatusCallback cb);
+    // Add files just pushed to the cache, for the next cold scratch, in
+    // the background: the push is done without it.
+    void fill_cache(const std::string& node, const std::string& scratch,
+                    const std::vector<const ManifestEntry*>& files);
+
+    struct DeltaReport {
+        size_t files = 0;
+        uint64_t raw_bytes = 0;    // size of the files sent as deltas
+        uint64_t wire_bytes = 0;   // signatures + instructions
+        std::vector<std::string> failed;
+    };
+    // Send each file as an rsync-style delta against the node's copy
+    // (prev holds its size). Files that couldn't go this way are returned
+    // in failed, for the caller to send whole.
+    DeltaReport push_deltas(const std::string& node, const std::string& scratch,
+                            const std::vector<ManifestEntry>& prev);
 
-    std::vector<ManifestEntry> build_manifest();
+    // Stat every file; content hashes are carried over from prev when
+    // mtime and size match, and computed (in parallel) otherwise.
+    std::vector<ManifestEntry> build_manifest(const std::vector<ManifestEntry>& prev);
+    // A file whose mtime changed but whose hash didn't is not resent; it
+    // is counted in touched.
     static void diff_manifests(const std::vector<ManifestEntry>& cur,
                                const std::vector<ManifestEntry>& prev,
                                std::vector<std::string>& changed,
-                               std::vector<std::string>& deleted);
+                               std::vector<std::string>& deleted,
+                               size_t& touched);
 };
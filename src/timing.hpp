@@ -0,0 +1,70 @@
+#pragma once
+
+#include <fmt/format.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ── Phase timing ──────────────────────────────────────────
+// Wall-clock time per phase of a multi-step operation (Session::start).
+// Phases run concurrently inside a group ("setup") are listed under it.
+class PhaseTimes {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name, group;
+        double secs;
+    };
+
+    static double since(clock::time_point t0) {
+        return std::chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    template <typename F>
+    auto time(const std::string& name, F&& fn, const std::string& group = "") {
+        auto t0 = clock::now();
+        auto result = fn();
+        record(name, since(t0), group);
+        return result;
+    }
+
+    void record(const std::string& name, double secs, const std::string& group = "") {
+        std::lock_guard<std::mutex> lock(mu_);
+        phases_.push_back({name, group, secs});
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mu_);
+        phases_.clear();
+    }
+
+    std::vector<Phase> phases() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return phases_;
+    }
+
+    // "allocate 0.4s, wait 12.0s [dtach 0.2s | scan 1.1s | stage 4.0s], setup 3.1s [container 3.1s | sync 1.4s], ..."
+    std::string summary() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        std::string out;
+        for (const auto& p : phases_) {
+            if (!p.group.empty()) continue;
+            if (!out.empty()) out += ", ";
+            out += fmt::format("{} {:.1f}s", p.name, p.secs);
+            std::string inner;
+            for (const auto& c : phases_) {
+                if (c.group != p.name) continue;
+                if (!inner.empty()) inner += " | ";
+                inner += fmt::format("{} {:.1f}s", c.name, c.secs);
+            }
+            if (!inner.empty()) out += " [" + inner + "]";
+        }
+        return out;
+    }
+
+private:
+    mutable std::mutex mu_;
+    std::vector<Phase> phases_;
+};
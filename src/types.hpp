@@ -54,6 +54,7 @@ struct ManifestEntry {
     std::string path;
     int64_t mtime;
     int64_t size;
+    uint64_t hash = 0;   // XXH64 of the contents, 0 = unknown
 };
 
 // ── Config structs ────────────────────────────────────────
@@ -72,6 +73,9 @@ struct ProjectConfig {
     std::string output = "output/";
     std::vector<int> ports;
     std::vector<std::string> rodata;
+    std::string compression = "auto";   // auto | off | zstd level 1-19
+    bool atomic_sync = false;           // stage pushes, then move into place
+    std::string streams = "auto";       // auto | parallel push streams 1-16
 };
 
 struct GlobalConfig {
@@ -86,6 +90,7 @@ struct GlobalConfig {
     std::string memory = "32G";
     std::string time = "4h";
     bool cache_containers = false;
+    bool file_cache = true;
 };
 
 struct Config {
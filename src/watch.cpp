@@ -0,0 +1,222 @@
+#include "watch.hpp"
+#include "debug.hpp"
+#include <fmt/format.h>
+#include <chrono>
+#include <thread>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+Watcher::Watcher(const fs::path& project_dir, const GitignoreParser& parser)
+    : project_dir_(project_dir), parser_(parser) {}
+
+#ifdef _WIN32
+// ── Windows: polling only ────────────────────────────────
+
+Watcher::~Watcher() {}
+bool Watcher::start() { return false; }
+bool Watcher::add_tree(const std::string&, std::set<std::string>*) { return false; }
+void Watcher::drop_tree(const std::string&) {}
+void Watcher::fall_back() {}
+void Watcher::read_events(WatchBatch&) {}
+
+WatchBatch Watcher::next(int, int, int) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+    WatchBatch batch;
+    batch.rescan = true;
+    return batch;
+}
+
+#else
+
+// Wait for stop_fd up to ms; true if it became readable.
+static bool wait_stop(int stop_fd, int ms) {
+    if (stop_fd < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        return false;
+    }
+    pollfd p{stop_fd, POLLIN, 0};
+    int r = poll(&p, 1, ms);
+    return r > 0;
+}
+
+#ifdef __linux__
+
+static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                       IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+
+Watcher::~Watcher() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool Watcher::start() {
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) return false;
+    if (!add_tree("", nullptr)) {
+        close(fd_);
+        fd_ = -1;
+        dirs_.clear();
+        return false;
+    }
+    debug_log("watch", fmt::format("watching {} directories", dirs_.size()));
+    return true;
+}
+
+bool Watcher::add_tree(const std::string& rel, std::set<std::string>* created) {
+    std::vector<std::string> todo{rel};
+    while (!todo.empty()) {
+        std::string dir = std::move(todo.back());
+        todo.pop_back();
+        fs::path full = dir.empty() ? project_dir_ : project_dir_ / dir;
+        int wd = inotify_add_watch(fd_, full.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            if (errno == ENOENT || errno == ENOTDIR) continue;  // already gone
+            debug_log("watch", fmt::format("inotify_add_watch {}: {}", full.string(), strerror(errno)));
+            return false;  // usually ENOSPC: out of watches
+        }
+        dirs_[wd] = dir;
+
+        std::error_code ec;
+        for (fs::directory_iterator it(full, ec), end; !ec && it != end; it.increment(ec)) {
+            std::string name = it->path().filename().string();
+            std::string child = dir.empty() ? name : dir + "/" + name;
+            std::error_code tec;
+            if (it->is_directory(tec)) {
+                if (!parser_.is_dir_ignored(child)) todo.push_back(child);
+            } else if (created && it->is_regular_file(tec)) {
+                created->insert(child);
+            }
+        }
+    }
+    return true;
+}
+
+void Watcher::drop_tree(const std::string& rel) {
+    std::string prefix = rel + "/";
+    for (auto it = dirs_.begin(); it != dirs_.end();) {
+        if (it->second == rel || it->second.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(fd_, it->first);
+            it = dirs_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Watcher::fall_back() {
+    debug_log("watch", "falling back to polling");
+    close(fd_);
+    fd_ = -1;
+    dirs_.clear();
+}
+
+void Watcher::read_events(WatchBatch& batch) {
+    alignas(inotify_event) char buf[64 * 1024];
+    while (true) {
+        ssize_t n = read(fd_, buf, sizeof(buf));
+        if (n <= 0) return;  // EAGAIN: drained
+        for (char* p = buf; p < buf + n;) {
+            auto* ev = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                batch.rescan = true;
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                dirs_.erase(ev->wd);
+                continue;
+            }
+            auto dir = dirs_.find(ev->wd);
+            if (dir == dirs_.end() || ev->len == 0) continue;
+            std::string rel = dir->second.empty() ? ev->name : dir->second + "/" + ev->name;
+
+            if (ev->mask & IN_ISDIR) {
+                if (parser_.is_dir_ignored(rel)) continue;
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    if (!add_tree(rel, &batch.paths)) {
+                        // Out of watches: this subtree would go unseen
+                        fall_back();
+                        batch.rescan = true;
+                        return;
+                    }
+                } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    drop_tree(rel);
+                    batch.paths.insert(rel);
+                }
+                continue;
+            }
+            if (!parser_.is_ignored(rel)) batch.paths.insert(rel);
+        }
+    }
+}
+
+WatchBatch Watcher::next(int quiet_ms, int max_ms, int stop_fd) {
+    WatchBatch batch;
+    if (fd_ < 0) {
+        if (wait_stop(stop_fd, POLL_MS)) batch.stopped = true;
+        else batch.rescan = true;
+        return batch;
+    }
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point first{};
+    bool any = false;
+    while (true) {
+        int timeout = -1;
+        if (any) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                first + std::chrono::milliseconds(max_ms) - clock::now()).count();
+            if (left <= 0) return batch;
+            timeout = static_cast<int>(std::min<int64_t>(quiet_ms, left));
+        }
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+        int r = poll(fds, stop_fd >= 0 ? 2 : 1, timeout);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            batch.rescan = true;
+            return batch;
+        }
+        if (r == 0) return batch;  // quiet for quiet_ms
+        if (stop_fd >= 0 && fds[1].revents) {
+            batch.stopped = true;
+            return batch;
+        }
+        read_events(batch);
+        if (fd_ < 0) return batch;  // fell back to polling
+        if (dirs_.empty()) {
+            // The project directory itself went away
+            batch.rescan = true;
+            return batch;
+        }
+        if (!any && (batch.rescan || !batch.paths.empty())) {
+            any = true;
+            first = clock::now();
+        }
+    }
+}
+
+#else  // other POSIX: no inotify
+
+Watcher::~Watcher() {}
+bool Watcher::start() { return false; }
+bool Watcher::add_tree(const std::string&, std::set<std::string>*) { return false; }
+void Watcher::drop_tree(const std::string&) {}
+void Watcher::fall_back() {}
+void Watcher::read_events(WatchBatch&) {}
+
+WatchBatch Watcher::next(int, int, int stop_fd) {
+    WatchBatch batch;
+    if (wait_stop(stop_fd, POLL_MS)) batch.stopped = true;
+    else batch.rescan = true;
+    return batch;
+}
+
+#endif
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "types.hpp"
+#include "sync.hpp"
+#include <set>
+#include <string>
+#include <unordered_map>
+
+// ── File watching ─────────────────────────────────────────
+// Change notification for `tccp sync --watch`. On Linux, one inotify watch
+// per non-ignored directory. Elsewhere, or once the inotify watch limit
+// is reached, it falls back to asking for a rescan every POLL_MS.
+
+struct WatchBatch {
+    std::set<std::string> paths;  // relative, '/'-separated; files or directories
+    bool rescan = false;          // events were lost: compare the whole tree
+    bool stopped = false;         // stop_fd became readable
+};
+
+class Watcher {
+public:
+    static constexpr int POLL_MS = 2000;
+
+    Watcher(const fs::path& project_dir, const GitignoreParser& parser);
+    ~Watcher();
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    // Returns false when falling back to polling.
+    bool start();
+    // Polling instead of events: from the start, or since the watch limit
+    // was hit while following new directories.
+    bool polling() const { return fd_ < 0; }
+    // Block until something not ignored changes, then keep collecting until
+    // nothing new arrives for quiet_ms (max_ms at most), so a burst of saves
+    // becomes one batch. A readable stop_fd (-1 = none) ends the wait.
+    WatchBatch next(int quiet_ms, int max_ms, int stop_fd);
+
+private:
+    fs::path project_dir_;
+    const GitignoreParser& parser_;
+    int fd_ = -1;
+    std::unordered_map<int, std::string> dirs_;  // watch descriptor → relative dir
+
+    // Watch rel and every non-ignored directory below it; files found
+    // there go into created (they may predate the watch).
+    bool add_tree(const std::string& rel, std::set<std::string>* created);
+    void drop_tree(const std::string& rel);
+    // Give up on events for the rest of the session (see polling()).
+    void fall_back();
+    void read_events(WatchBatch& batch);
+};
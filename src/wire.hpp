@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ── Wire helpers ──────────────────────────────────────────
+// Big-endian integers and u32-length-prefixed strings, shared by the
+// remote agent and the local daemon protocols. Frames themselves are a
+// u32 length followed by the body.
+
+struct WireOut {
+    std::string b;
+    void u8(uint8_t v) { b.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v) {
+        for (int s = 24; s >= 0; s -= 8) b.push_back(static_cast<char>((v >> s) & 0xff));
+    }
+    void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+    void i64(int64_t v) {
+        u32(static_cast<uint32_t>(static_cast<uint64_t>(v) >> 32));
+        u32(static_cast<uint32_t>(v));
+    }
+    void str(const std::string& s) { u32(static_cast<uint32_t>(s.size())); b += s; }
+    void raw(const char* data, size_t len) { b.append(data, len); }
+};
+
+struct WireIn {
+    const std::string& b;
+    size_t o = 0;
+    bool bad = false;
+
+    explicit WireIn(const std::string& buf) : b(buf) {}
+    bool need(size_t n) {
+        if (bad || o + n > b.size()) { bad = true; return false; }
+        return true;
+    }
+    uint64_t be(size_t n) {
+        if (!need(n)) return 0;
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; i++) v = (v << 8) | static_cast<uint8_t>(b[o + i]);
+        o += n;
+        return v;
+    }
+    uint8_t u8() { return static_cast<uint8_t>(be(1)); }
+    uint32_t u32() { return static_cast<uint32_t>(be(4)); }
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    int64_t i64() { return static_cast<int64_t>(be(8)); }
+    std::string str() {
+        uint32_t n = u32();
+        if (!need(n)) return "";
+        std::string s = b.substr(o, n);
+        o += n;
+        return s;
+    }
+    // Fixed-size field without a length prefix.
+    std::string bytes(size_t n) {
+        if (!need(n)) return "";
+        std::string s = b.substr(o, n);
+        o += n;
+        return s;
+    }
+    // Everything not yet consumed.
+    std::string rest() {
+        std::string s = b.substr(o);
+        o = b.size();
+        return s;
+    }
+};